@@ -25,6 +25,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 struct {
   struct spinlock lock;
@@ -70,14 +71,15 @@ bget(uint dev, uint blockno)
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
       release(&bcache.lock);
+      TRACE(TR_BHIT, blockno, dev);
       acquiresleep(&b->lock);
       return b;
     }
   }
 
   // Not cached; recycle an unused buffer.
-  // Even if refcnt==0, B_DIRTY indicates a buffer is in use
-  // because log.c has modified it but not yet committed it.
+  // Blocks that log.c has modified but not yet installed
+  // are pinned with bpin(), so their refcnt is never 0 here.
   for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
     if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
       b->dev = dev;
@@ -85,6 +87,7 @@ bget(uint dev, uint blockno)
       b->flags = 0;
       b->refcnt = 1;
       release(&bcache.lock);
+      TRACE(TR_BMISS, blockno, dev);
       acquiresleep(&b->lock);
       return b;
     }
@@ -139,6 +142,24 @@ brelse(struct buf *b)
   
   release(&bcache.lock);
 }
+
+// Keep b in the cache even after the last brelse().
+// The log pins each block it has to install.
+void
+bpin(struct buf *b)
+{
+  acquire(&bcache.lock);
+  b->refcnt++;
+  release(&bcache.lock);
+}
+
+void
+bunpin(struct buf *b)
+{
+  acquire(&bcache.lock);
+  b->refcnt--;
+  release(&bcache.lock);
+}
 //PAGEBREAK!
 // Blank page.
 
@@ -14,6 +14,7 @@
 #include "mmu.h"
 #include "proc.h"
 #include "x86.h"
+#include "poll.h"
 
 static void consputc(int);
 
@@ -184,6 +185,7 @@ struct {
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+  struct epitem *watch;  // epoll items watching the console
 } input;
 
 #define C(x)  ((x)-'@')  // Control-x
@@ -221,6 +223,7 @@ consoleintr(int (*getc)(void))
         if(c == '\n' || c == C('D') || input.e == input.r+INPUT_BUF){
           input.w = input.e;
           wakeup(&input.r);
+          pollwakeup(input.watch, POLLIN);
         }
       }
       break;
@@ -242,6 +245,10 @@ consoleread(struct inode *ip, char *dst, int n)
   target = n;
   acquire(&cons.lock);
   while(n > 0){
+    // A full buffer without a newline ends the read,
+    // so that poll() saying POLLIN means it won't block.
+    if(input.r == input.w && n < target)
+      break;
     while(input.r == input.w){
       if(myproc()->killed){
         release(&cons.lock);
@@ -270,6 +277,27 @@ consoleread(struct inode *ip, char *dst, int n)
   return target - n;
 }
 
+int
+consolepoll(struct inode *ip)
+{
+  int r;
+
+  acquire(&cons.lock);
+  r = POLLOUT;
+  if(input.r != input.w)
+    r |= POLLIN;
+  release(&cons.lock);
+  return r;
+}
+
+void
+consolewatch(struct inode *ip, struct epitem *it, int on)
+{
+  acquire(&cons.lock);
+  pollwatch(&input.watch, it, on);
+  release(&cons.lock);
+}
+
 int
 consolewrite(struct inode *ip, char *buf, int n)
 {
@@ -292,6 +320,8 @@ consoleinit(void)
 
   devsw[CONSOLE].write = consolewrite;
   devsw[CONSOLE].read = consoleread;
+  devsw[CONSOLE].poll = consolepoll;
+  devsw[CONSOLE].watch = consolewatch;
   cons.locking = 1;
 
   ioapicenable(IRQ_KBD, 0);
@@ -1,20 +1,37 @@
 struct buf;
 struct context;
+struct epitem;
+struct epoll;
+struct epoll_event;
 struct file;
 struct inode;
+struct io_ring;
+struct iovec;
+struct lockclass;
+struct lockstat;
 struct pipe;
+struct pollfd;
 struct proc;
+struct procinfo;
+struct profsample;
 struct rtcdate;
+struct rusage;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct tracerec;
+struct trapframe;
+struct vdata;
+struct vproc;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bpin(struct buf*);
+void            bunpin(struct buf*);
 
 // console.c
 void            consoleinit(void);
@@ -31,13 +48,22 @@ void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, char*, int n);
+int             filereadv(struct file*, struct iovec*, int);
+int             filepread(struct file*, char*, int n, uint);
+int             filesplice(struct file*, struct file*, int);
 int             filestat(struct file*, struct stat*);
 int             filewrite(struct file*, char*, int n);
+int             filewritev(struct file*, struct iovec*, int);
+int             filepwrite(struct file*, char*, int n, uint);
+int             filepoll(struct file*, int);
+void            filewatch(struct file*, struct epitem*, int);
 
 // fs.c
 void            readsb(int dev, struct superblock *sb);
+void            allocinit(int dev);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+void            dirunlink(struct inode*, char*, uint);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit(int dev);
@@ -50,6 +76,7 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, char*, uint, uint);
+int             readipipe(struct inode*, uint, uint, struct pipe*);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
 
@@ -57,6 +84,7 @@ int             writei(struct inode*, char*, uint, uint);
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            iderwv(struct buf**, int);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -85,6 +113,9 @@ void            microdelay(int);
 void            initlog(int dev);
 void            log_write(struct buf*);
 void            begin_op();
+void            begin_opn(int);
+void            log_force(void);
+void            logtick(void);
 void            end_op();
 
 // mp.c
@@ -98,8 +129,25 @@ void            picinit(void);
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, char*, int);
-int             pipewrite(struct pipe*, char*, int);
+int             piperead(struct pipe*, char*, int, int);
+int             pipewrite(struct pipe*, char*, int, int);
+int             pipeput(struct pipe*, char*, int);
+int             pipewaitw(struct pipe*, int);
+int             pipesize(struct pipe*, int);
+int             pipepoll(struct pipe*, int);
+void            pipewatch(struct pipe*, struct epitem*, int);
+
+// poll.c
+void            epollclose(struct epoll*);
+struct epoll*   epollcreate(void);
+int             epollctl(struct epoll*, int, int, struct epoll_event*);
+void            epollforget(struct file*);
+int             epollwait(struct epoll*, struct epoll_event*, int, int);
+void            pollinit(void);
+int             poll(struct pollfd*, int, int);
+void            polltick(void);
+void            pollwatch(struct epitem**, struct epitem*, int);
+void            pollwakeup(struct epitem*, int);
 
 //PAGEBREAK: 16
 // proc.c
@@ -108,6 +156,7 @@ void            exit(void);
 int             fork(void);
 int             growproc(int);
 int             kill(int);
+int             kthread(char*, void (*)(void));
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
@@ -119,11 +168,21 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
+void            wakeupone(void*);
 void            yield(void);
 int             waitx(int *, int *);
 void            inc_time(void);
 int             set_priority(int, int);
-int             my_ps(void);
+int             getprocs(struct procinfo*, int);
+int             getrusage(int, struct rusage*);
+void            rucharge(int);
+int             wait4(int, struct rusage*);
+
+// profile.c
+void            profinit(void);
+int             profile(int);
+int             profread(struct profsample*, int);
+void            proftick(struct trapframe*);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -133,6 +192,10 @@ void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+struct lockclass* lockclass(char*, int);
+void            lockstatacq(struct lockclass*, uint, int);
+void            lockstathold(struct lockclass*, uint);
+int             lockstatread(struct lockstat*, int, int);
 void            release(struct spinlock*);
 void            pushcli(void);
 void            popcli(void);
@@ -157,6 +220,7 @@ int             argint(int, int*);
 int             argptr(int, char**, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
+int             fetchptr(uint, int, char**);
 int             fetchstr(uint, char**);
 void            syscall(void);
 
@@ -169,12 +233,29 @@ extern uint     ticks;
 void            tvinit(void);
 extern struct spinlock tickslock;
 
+// trace.c
+void            traceinit(void);
+int             traceread(struct tracerec*, int);
+#ifdef TRACING
+void            trace(int, uint, uint);
+#define TRACE(type, a, b) trace(type, a, b)
+#else
+#define TRACE(type, a, b) do { } while(0)
+#endif
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
 
+// vdso.c
+extern struct vdata *vdata;
+uint            tscus(unsigned long long);
+void            vdsoinit(void);
+void            vdsotick(void);
+
 // vm.c
+extern int      nosysenter;
 void            seginit(void);
 void            kvmalloc(void);
 pde_t*          setupkvm(void);
@@ -189,6 +270,7 @@ void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+int             vdsomap(pde_t*, struct vproc*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
@@ -1,4 +1,11 @@
 #define O_RDONLY  0x000
 #define O_WRONLY  0x001
 #define O_RDWR    0x002
+#define O_NONBLOCK 0x004
 #define O_CREATE  0x200
+
+// fcntl() commands
+#define F_GETPIPE_SZ  1  // get a pipe's buffer size
+#define F_SETPIPE_SZ  2  // set it to at least arg bytes
+#define F_GETFL       3  // get the open mode and O_NONBLOCK
+#define F_SETFL       4  // set O_NONBLOCK from arg
@@ -5,10 +5,14 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "mmu.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "stat.h"
+#include "uio.h"
+#include "poll.h"
 
 struct devsw devsw[NDEV];
 struct {
@@ -61,6 +65,13 @@ fileclose(struct file *f)
   acquire(&ftable.lock);
   if(f->ref < 1)
     panic("fileclose");
+  if(f->ref == 1 && f->epitems){
+    // Leave the epolls watching f while it is still ours;
+    // no one else can add it to one now.
+    release(&ftable.lock);
+    epollforget(f);
+    acquire(&ftable.lock);
+  }
   if(--f->ref > 0){
     release(&ftable.lock);
     return;
@@ -72,6 +83,8 @@ fileclose(struct file *f)
 
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
+  else if(ff.type == FD_EPOLL)
+    epollclose(ff.ep);
   else if(ff.type == FD_INODE){
     begin_op();
     iput(ff.ip);
@@ -92,66 +105,311 @@ filestat(struct file *f, struct stat *st)
   return -1;
 }
 
+// Return the poll events a device inode is ready for.
+static int
+devpoll(struct inode *ip)
+{
+  if(ip->major < 0 || ip->major >= NDEV || !devsw[ip->major].poll)
+    return POLLIN | POLLOUT;
+  return devsw[ip->major].poll(ip);
+}
+
+// Return which of events file f is ready for.
+// POLLERR and POLLHUP are returned even if not asked for.
+int
+filepoll(struct file *f, int events)
+{
+  int r;
+
+  if(f->type == FD_PIPE)
+    r = pipepoll(f->pipe, f->writable);
+  else if(f->type == FD_INODE && f->ip->type == T_DEV)
+    r = devpoll(f->ip);
+  else
+    r = POLLIN | POLLOUT;
+  if(!f->readable)
+    r &= ~POLLIN;
+  if(!f->writable)
+    r &= ~POLLOUT;
+  return r & (events | POLLERR | POLLHUP);
+}
+
+// Add epoll item it to the items notified when file f
+// changes, or remove it if on is not set. Regular files
+// are always ready and never notify.
+void
+filewatch(struct file *f, struct epitem *it, int on)
+{
+  if(f->type == FD_PIPE)
+    pipewatch(f->pipe, it, on);
+  else if(f->type == FD_INODE && f->ip->type == T_DEV &&
+          f->ip->major >= 0 && f->ip->major < NDEV && devsw[f->ip->major].watch)
+    devsw[f->ip->major].watch(f->ip, it, on);
+}
+
+// Read inode file f at *off into the cnt buffers in iov,
+// advancing *off, under a single ilock().
+static int
+ireadv(struct file *f, struct iovec *iov, int cnt, uint *off)
+{
+  int i, r, tot;
+
+  tot = 0;
+  ilock(f->ip);
+  for(i = 0; i < cnt; i++){
+    if((r = readi(f->ip, iov[i].iov_base, *off, iov[i].iov_len)) < 0){
+      if(tot == 0)
+        tot = -1;
+      break;
+    }
+    *off += r;
+    tot += r;
+    if(r < iov[i].iov_len)
+      break;
+  }
+  iunlock(f->ip);
+  return tot;
+}
+
 // Read from file f.
 int
 fileread(struct file *f, char *addr, int n)
 {
-  int r;
+  struct iovec iov;
 
   if(f->readable == 0)
     return -1;
   if(f->type == FD_PIPE)
-    return piperead(f->pipe, addr, n);
+    return piperead(f->pipe, addr, n, f->nonblock);
   if(f->type == FD_INODE){
-    ilock(f->ip);
-    if((r = readi(f->ip, addr, f->off, n)) > 0)
-      f->off += r;
-    iunlock(f->ip);
-    return r;
+    if(f->nonblock && f->ip->type == T_DEV && !(devpoll(f->ip) & POLLIN))
+      return -1;
+    iov.iov_base = addr;
+    iov.iov_len = n;
+    return ireadv(f, &iov, 1, &f->off);
   }
   panic("fileread");
 }
 
+// Read from file f into the cnt buffers in iov.
+// A pipe read fills only the first non-empty buffer.
+int
+filereadv(struct file *f, struct iovec *iov, int cnt)
+{
+  int i;
+
+  if(f->readable == 0)
+    return -1;
+  if(f->type == FD_PIPE){
+    for(i = 0; i < cnt; i++)
+      if(iov[i].iov_len > 0)
+        return piperead(f->pipe, iov[i].iov_base, iov[i].iov_len, f->nonblock);
+    return 0;
+  }
+  if(f->type == FD_INODE){
+    if(f->nonblock && f->ip->type == T_DEV && !(devpoll(f->ip) & POLLIN))
+      return -1;
+    return ireadv(f, iov, cnt, &f->off);
+  }
+  panic("filereadv");
+}
+
+// Read from file f at offset off, leaving f->off alone.
+int
+filepread(struct file *f, char *addr, int n, uint off)
+{
+  struct iovec iov;
+
+  if(f->readable == 0 || f->type != FD_INODE)
+    return -1;
+  iov.iov_base = addr;
+  iov.iov_len = n;
+  return ireadv(f, &iov, 1, &off);
+}
+
+// Blocks a write of n bytes may log: its data blocks (one
+// more if not block-aligned), the i-node, up to 3 indirect
+// blocks (a double-indirect block and the two indirect blocks
+// below it that a chunk can span), and the bitmap blocks of
+// every block it allocates.
+static int
+writeblocks(int n)
+{
+  int nb = n/BSIZE + 2;
+
+  return nb + 1 + 3 + (nb + 3 < BMAPBLOCKS ? nb + 3 : BMAPBLOCKS);
+}
+
 //PAGEBREAK!
+// Write the cnt buffers in iov to inode file f at *off,
+// advancing *off. Buffers are gathered into chunks, so
+// small ones share a transaction.
+static int
+iwritev(struct file *f, struct iovec *iov, int cnt, uint *off)
+{
+  int i, n, r, m, v, vo, left;
+
+  // write a few blocks at a time to avoid exceeding
+  // the maximum log transaction size. each chunk
+  // reserves only the blocks it may log, see writeblocks().
+  // this really belongs lower down, since writei()
+  // might be writing a device like the console.
+  int max = MAXWRITEBLOCKS - 6 - BMAPBLOCKS;
+  if(max < (MAXWRITEBLOCKS - 11) / 2)
+    max = (MAXWRITEBLOCKS - 11) / 2;
+  max *= BSIZE;
+
+  n = 0;
+  for(v = 0; v < cnt; v++)
+    n += iov[v].iov_len;
+
+  i = v = vo = r = 0;
+  while(i < n){
+    int n1 = n - i;
+    if(n1 > max)
+      n1 = max;
+
+    begin_opn(writeblocks(n1));
+    ilock(f->ip);
+    for(left = n1; left > 0; left -= m){
+      m = iov[v].iov_len - vo;
+      if(m > left)
+        m = left;
+      if((r = writei(f->ip, (char*)iov[v].iov_base + vo, *off, m)) != m)
+        break;
+      *off += m;
+      i += m;
+      if((vo += m) == iov[v].iov_len){
+        v++;
+        vo = 0;
+      }
+    }
+    iunlock(f->ip);
+    end_op();
+
+    if(r < 0)
+      break;
+    if(left > 0)
+      panic("short filewrite");
+  }
+  return i == n ? n : -1;
+}
+
 // Write to file f.
 int
 filewrite(struct file *f, char *addr, int n)
 {
-  int r;
+  struct iovec iov;
 
   if(f->writable == 0)
     return -1;
   if(f->type == FD_PIPE)
-    return pipewrite(f->pipe, addr, n);
+    return pipewrite(f->pipe, addr, n, f->nonblock);
   if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_op();
-      ilock(f->ip);
-      if ((r = writei(f->ip, addr + i, f->off, n1)) > 0)
-        f->off += r;
-      iunlock(f->ip);
-      end_op();
+    iov.iov_base = addr;
+    iov.iov_len = n;
+    return iwritev(f, &iov, 1, &f->off);
+  }
+  panic("filewrite");
+}
+
+// Write the cnt buffers in iov to file f.
+int
+filewritev(struct file *f, struct iovec *iov, int cnt)
+{
+  int i, n, r;
 
+  if(f->writable == 0)
+    return -1;
+  if(f->type == FD_PIPE){
+    for(i = n = 0; i < cnt; i++){
+      r = pipewrite(f->pipe, iov[i].iov_base, iov[i].iov_len, f->nonblock);
       if(r < 0)
+        return n > 0 ? n : -1;
+      n += r;
+      if(r < iov[i].iov_len)
         break;
-      if(r != n1)
-        panic("short filewrite");
-      i += r;
     }
-    return i == n ? n : -1;
+    return n;
   }
-  panic("filewrite");
+  if(f->type == FD_INODE)
+    return iwritev(f, iov, cnt, &f->off);
+  panic("filewritev");
+}
+
+// Write to file f at offset off, leaving f->off alone.
+int
+filepwrite(struct file *f, char *addr, int n, uint off)
+{
+  struct iovec iov;
+
+  if(f->writable == 0 || f->type != FD_INODE)
+    return -1;
+  iov.iov_base = addr;
+  iov.iov_len = n;
+  return iwritev(f, &iov, 1, &off);
+}
+
+// Move up to n bytes from file in to file out inside the
+// kernel. Returns the number moved, 0 at end of input.
+int
+filesplice(struct file *in, struct file *out, int n)
+{
+  char *buf;
+  int r, w, m, tot;
+
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+
+  if(in->type == FD_INODE && in->ip->type != T_DEV && out->type == FD_PIPE){
+    // Copy from the buffer cache straight into the pipe.
+    for(tot = 0; tot < n; tot += r){
+      if(pipewaitw(out->pipe, out->nonblock) < 0)
+        return tot > 0 ? tot : -1;
+      ilock(in->ip);
+      if(in->off >= in->ip->size){
+        iunlock(in->ip);
+        break;
+      }
+      if((r = readipipe(in->ip, in->off, n - tot, out->pipe)) > 0)
+        in->off += r;
+      iunlock(in->ip);
+      if(r < 0)
+        return tot > 0 ? tot : -1;
+    }
+    return tot;
+  }
+
+  // Otherwise copy through a kernel page.
+  if((buf = kalloc()) == 0)
+    return -1;
+  r = 0;
+  for(tot = 0; tot < n; tot += r){
+    m = n - tot < PGSIZE ? n - tot : PGSIZE;
+    if(out->type == FD_PIPE && pipewaitw(out->pipe, out->nonblock) < 0){
+      r = -1;
+      break;
+    }
+    if((r = fileread(in, buf, m)) <= 0)
+      break;
+    // The data has been consumed from in, so wait
+    // for room for all of it even if out is O_NONBLOCK.
+    if(out->type == FD_PIPE)
+      w = pipewrite(out->pipe, buf, r, 0);
+    else
+      w = filewrite(out, buf, r);
+    if(w != r){
+      r = -1;
+      break;
+    }
+    if(r < m){
+      tot += r;
+      break;
+    }
+  }
+  kfree(buf);
+  if(r < 0 && tot == 0)
+    return -1;
+  return tot;
 }
 
@@ -1,10 +1,13 @@
 struct file {
-  enum { FD_NONE, FD_PIPE, FD_INODE } type;
+  enum { FD_NONE, FD_PIPE, FD_INODE, FD_EPOLL } type;
   int ref; // reference count
   char readable;
   char writable;
+  char nonblock;  // O_NONBLOCK: fail rather than wait
   struct pipe *pipe;
   struct inode *ip;
+  struct epoll *ep;
+  struct epitem *epitems;  // epoll items watching this file
   uint off;
 };
 
@@ -14,6 +17,9 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *hnext;  // icache hash chain
+  struct inode *lprev;  // icache LRU list, while ref is 0
+  struct inode *lnext;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -22,7 +28,17 @@ struct inode {
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  uint addrs[NDIRECT+2];
+
+  // Runs of consecutive blocks mapped by the indirect
+  // blocks, so bmap() need not read them again.
+  struct maprun {
+    uint bn;          // first file block of the run
+    uint addr;        // its disk block
+    uint len;         // number of blocks, 0 if unused
+  } runs[NMAPRUN];
+  uint nextrun;       // next runs[] slot to replace
+  uint lastblock;     // block bmap() allocated last, or 0
 };
 
 // table mapping major device number to
@@ -30,6 +46,8 @@ struct inode {
 struct devsw {
   int (*read)(struct inode*, char*, int);
   int (*write)(struct inode*, char*, int);
+  int (*poll)(struct inode*);  // ready poll events, or null if always ready
+  void (*watch)(struct inode*, struct epitem*, int);  // add or remove an epoll item
 };
 
 extern struct devsw devsw[];
@@ -23,6 +23,8 @@
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void itrunc(struct inode*);
+static void dcinit(void);
+static void dcpurge(uint, uint);
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb; 
@@ -50,27 +52,113 @@ bzero(int dev, int bno)
   brelse(bp);
 }
 
+// Allocation summary.
+//
+// For each bitmap block and each inode block the kernel keeps
+// the number of free entries it holds and a hint below which
+// none are free, so balloc() and ialloc() skip full blocks
+// without reading them. An entry only changes while the disk
+// block it describes is locked, which keeps it exact; anyone
+// may read it without a lock, as a hint.
+struct {
+  int nbmap;
+  int bfree[BMAPBLOCKS];  // free blocks per bitmap block
+  int bnext[BMAPBLOCKS];  // no free bit below this one
+  int ngroup;
+  int ifree[IBLOCKS];     // free inodes per inode block
+  int inext[IBLOCKS];     // no free inode below this inum
+} alloc;
+
+// Return the first clear bit of map in [from, to), or -1.
+static int
+bitfind(uchar *map, int from, int to)
+{
+  int bi;
+
+  for(bi = from; bi < to; bi++){
+    if(bi % 8 == 0 && map[bi/8] == 0xff){
+      bi += 7;
+      continue;
+    }
+    if((map[bi/8] & (1 << (bi % 8))) == 0)
+      return bi;
+  }
+  return -1;
+}
+
+// Build the allocation summary from the disk.
+// Must run after the log has been recovered.
+void
+allocinit(int dev)
+{
+  int k, g, n, bi, inum;
+  struct buf *bp;
+  struct dinode *dip;
+
+  alloc.nbmap = (sb.size + BPB - 1) / BPB;
+  alloc.ngroup = (sb.ninodes + IPB - 1) / IPB;
+  if(alloc.nbmap > BMAPBLOCKS || alloc.ngroup > IBLOCKS)
+    panic("allocinit: file system too big");
+
+  for(k = 0; k < alloc.nbmap; k++){
+    n = min(BPB, sb.size - k*BPB);
+    bp = bread(dev, sb.bmapstart + k);
+    alloc.bfree[k] = 0;
+    alloc.bnext[k] = n;
+    for(bi = n - 1; bi >= 0; bi--){
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0){
+        alloc.bfree[k]++;
+        alloc.bnext[k] = bi;
+      }
+    }
+    brelse(bp);
+  }
+
+  for(g = 0; g < alloc.ngroup; g++){
+    bp = bread(dev, sb.inodestart + g);
+    alloc.ifree[g] = 0;
+    alloc.inext[g] = (g + 1) * IPB;
+    for(inum = (g + 1) * IPB - 1; inum >= g * IPB; inum--){
+      dip = (struct dinode*)bp->data + inum%IPB;
+      if(inum > 0 && inum < sb.ninodes && dip->type == 0){
+        alloc.ifree[g]++;
+        alloc.inext[g] = inum;
+      }
+    }
+    brelse(bp);
+  }
+}
+
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Allocate a zeroed disk block, the first free one at or
+// after goal if there is one.
 static uint
-balloc(uint dev)
+balloc(uint dev, uint goal)
 {
-  int b, bi, m;
+  int i, k, b, bi;
   struct buf *bp;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
+  if(goal >= sb.size)
+    goal = 0;
+  for(i = 0; i <= alloc.nbmap; i++){
+    k = (goal/BPB + i) % alloc.nbmap;
+    if(alloc.bfree[k] == 0)
+      continue;
+    b = k * BPB;
     bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
-      }
+    bi = alloc.bnext[k];
+    if(i == 0 && goal % BPB > bi)
+      bi = goal % BPB;
+    if((bi = bitfind(bp->data, bi, min(BPB, sb.size - b))) >= 0){
+      bp->data[bi/8] |= 1 << (bi % 8);  // Mark block in use.
+      log_write(bp);
+      alloc.bfree[k]--;
+      if(bi == alloc.bnext[k])
+        alloc.bnext[k] = bi + 1;
+      brelse(bp);
+      bzero(dev, b + bi);
+      return b + bi;
     }
     brelse(bp);
   }
@@ -91,6 +179,9 @@ bfree(int dev, uint b)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
   log_write(bp);
+  alloc.bfree[b/BPB]++;
+  if(bi < alloc.bnext[b/BPB])
+    alloc.bnext[b/BPB] = bi;
   brelse(bp);
 }
 
@@ -119,18 +210,18 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in cache: an entry in the inode cache
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a cache entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in cache: ip->ref tracks the number of
+//   in-memory pointers to the entry (open files and current
+//   directories). iget() finds or creates a cache entry and
+//   increments its ref; iput() decrements ref. An entry whose
+//   ref is zero stays cached, on an LRU list, until iget()
+//   recycles it for another inode.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   cache entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
-//   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   the disk and sets ip->valid, while iget() clears
+//   ip->valid when it recycles the entry.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -154,35 +245,48 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// Cached inodes are found through a hash table on (dev, inum)
+// and allocated a page at a time, so the cache grows while all
+// of its entries are in use. Once it holds NINODE entries,
+// iget() recycles the least recently used unreferenced one.
+//
+// The icache.lock spin-lock protects the hash chains, the LRU
+// list and the allocation of entries. ip->dev and ip->inum
+// only change under icache.lock while ip->ref is zero, and
+// ip->ref only changes atomically, so iget() can look up an
+// inode that is in use without the lock: it walks the hash
+// chain, raises a non-zero ref with cmpxchg, and then checks
+// that the entry still holds the inode it wanted.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
-// dev, and inum.  One must hold ip->lock in order to
+// dev, inum and the list links.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIHASH 61
+
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *hash[NIHASH];
+  struct inode *lruhead;  // unreferenced entries, least
+  struct inode *lrutail;  // recently used first
+  int n;                  // entries allocated
 } icache;
 
+#define IHASH(dev, inum) (((dev)*31 + (inum)) % NIHASH)
+
 void
 iinit(int dev)
 {
-  int i = 0;
-  
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
-  }
+  dcinit();
 
   readsb(dev, &sb);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
- inodestart %d bmap start %d\n", sb.size, sb.nblocks,
+ inodestart %d bmap start %d bsize %d\n", sb.size, sb.nblocks,
           sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
-          sb.bmapstart);
+          sb.bmapstart, sb.bsize);
+  if(sb.bsize != BSIZE)
+    panic("iinit: block size");
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -194,25 +298,54 @@ static struct inode* iget(uint dev, uint inum);
 struct inode*
 ialloc(uint dev, short type)
 {
-  int inum;
+  int g, inum;
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
-    bp = bread(dev, IBLOCK(inum, sb));
-    dip = (struct dinode*)bp->data + inum%IPB;
-    if(dip->type == 0){  // a free inode
-      memset(dip, 0, sizeof(*dip));
-      dip->type = type;
-      log_write(bp);   // mark it allocated on the disk
-      brelse(bp);
-      return iget(dev, inum);
+  for(g = 0; g < alloc.ngroup; g++){
+    if(alloc.ifree[g] == 0)
+      continue;
+    bp = bread(dev, sb.inodestart + g);
+    for(inum = alloc.inext[g]; inum < (g+1)*IPB && inum < sb.ninodes; inum++){
+      dip = (struct dinode*)bp->data + inum%IPB;
+      if(dip->type == 0){  // a free inode
+        memset(dip, 0, sizeof(*dip));
+        dip->type = type;
+        log_write(bp);   // mark it allocated on the disk
+        alloc.ifree[g]--;
+        alloc.inext[g] = inum + 1;
+        brelse(bp);
+        return iget(dev, inum);
+      }
     }
     brelse(bp);
   }
   panic("ialloc: no inodes");
 }
 
+// Free inode ip on disk.
+// Caller must hold ip->lock.
+static void
+ifree(struct inode *ip)
+{
+  struct buf *bp;
+  struct dinode *dip;
+  int g;
+
+  if(ip->type == T_DIR)
+    dcpurge(ip->dev, ip->inum);
+  ip->type = 0;
+  bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+  dip = (struct dinode*)bp->data + ip->inum%IPB;
+  memset(dip, 0, sizeof(*dip));
+  log_write(bp);
+  g = ip->inum / IPB;
+  alloc.ifree[g]++;
+  if(ip->inum < alloc.inext[g])
+    alloc.inext[g] = ip->inum;
+  brelse(bp);
+}
+
 // Copy a modified in-memory inode to disk.
 // Must be called after every change to an ip->xxx field
 // that lives on disk, since i-node cache is write-through.
@@ -235,37 +368,121 @@ iupdate(struct inode *ip)
   brelse(bp);
 }
 
+// LRU list of unreferenced entries.
+// Caller must hold icache.lock.
+static void
+lruappend(struct inode *ip)
+{
+  ip->lnext = 0;
+  ip->lprev = icache.lrutail;
+  if(icache.lrutail)
+    icache.lrutail->lnext = ip;
+  else
+    icache.lruhead = ip;
+  icache.lrutail = ip;
+}
+
+static void
+lruremove(struct inode *ip)
+{
+  if(ip->lprev)
+    ip->lprev->lnext = ip->lnext;
+  else
+    icache.lruhead = ip->lnext;
+  if(ip->lnext)
+    ip->lnext->lprev = ip->lprev;
+  else
+    icache.lrutail = ip->lprev;
+}
+
+// Add a page of unused entries to the cache.
+// Caller must hold icache.lock.
+static int
+igrow(void)
+{
+  struct inode *ip, *end;
+  char *p;
+
+  if((p = kalloc()) == 0)
+    return 0;
+  memset(p, 0, PGSIZE);
+  end = (struct inode*)p + PGSIZE/sizeof(struct inode);
+  for(ip = (struct inode*)p; ip < end; ip++){
+    initsleeplock(&ip->lock, "inode");
+    lruappend(ip);
+    icache.n++;
+  }
+  return 1;
+}
+
+// Take a reference to the cached inode (dev, inum) if it
+// is in use, without icache.lock. Returns 0 otherwise.
+static struct inode*
+ifind(uint dev, uint inum)
+{
+  struct inode *ip;
+  int r;
+
+  for(ip = icache.hash[IHASH(dev, inum)]; ip; ip = ip->hnext){
+    if(ip->dev != dev || ip->inum != inum)
+      continue;
+    for(r = ip->ref; r > 0; r = ip->ref){
+      if(__sync_bool_compare_and_swap(&ip->ref, r, r+1)){
+        if(ip->dev == dev && ip->inum == inum)
+          return ip;
+        iput(ip);  // recycled under us
+        return 0;
+      }
+    }
+    return 0;
+  }
+  return 0;
+}
+
 // Find the inode with number inum on device dev
 // and return the in-memory copy. Does not lock
 // the inode and does not read it from disk.
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip, **pp;
+
+  if((ip = ifind(dev, inum)) != 0)
+    return ip;
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  for(ip = icache.hash[IHASH(dev, inum)]; ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref == 0)
+        lruremove(ip);
+      __sync_fetch_and_add(&ip->ref, 1);
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Recycle the least recently used entry, growing
+  // the cache first if it is small or all in use.
+  if((icache.lruhead == 0 || icache.n < NINODE) && !igrow() &&
+     icache.lruhead == 0)
     panic("iget: no inodes");
-
-  ip = empty;
+  ip = icache.lruhead;
+  lruremove(ip);
+  if(ip->inum){
+    for(pp = &icache.hash[IHASH(ip->dev, ip->inum)]; *pp != ip; pp = &(*pp)->hnext)
+      ;
+    *pp = ip->hnext;
+  }
+  ip->valid = 0;
   ip->dev = dev;
   ip->inum = inum;
+  __sync_synchronize();
   ip->ref = 1;
-  ip->valid = 0;
+  ip->hnext = icache.hash[IHASH(dev, inum)];
+  __sync_synchronize();
+  icache.hash[IHASH(dev, inum)] = ip;
   release(&icache.lock);
 
   return ip;
@@ -276,9 +493,7 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&icache.lock);
-  ip->ref++;
-  release(&icache.lock);
+  __sync_fetch_and_add(&ip->ref, 1);
   return ip;
 }
 
@@ -305,6 +520,8 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    memset(ip->runs, 0, sizeof(ip->runs));
+    ip->lastblock = 0;
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -322,8 +539,8 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode cache entry can
-// be recycled.
+// If that was the last reference, the inode cache entry goes
+// on the LRU list and can be recycled.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -339,15 +556,15 @@ iput(struct inode *ip)
     if(r == 1){
       // inode has no links and no other references: truncate and free.
       itrunc(ip);
-      ip->type = 0;
-      iupdate(ip);
+      ifree(ip);
       ip->valid = 0;
     }
   }
   releasesleep(&ip->lock);
 
   acquire(&icache.lock);
-  ip->ref--;
+  if(__sync_sub_and_fetch(&ip->ref, 1) == 0)
+    lruappend(ip);
   release(&icache.lock);
 }
 
@@ -365,34 +582,128 @@ iunlockput(struct inode *ip)
 // The content (data) associated with each inode is stored
 // in blocks on the disk. The first NDIRECT block numbers
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// listed in block ip->addrs[NDIRECT].  The NDINDIRECT blocks
+// after those are listed in the indirect blocks that are in
+// turn listed in block ip->addrs[NDIRECT+1].
+//
+// Looking a block up through the indirect blocks costs a
+// bread() per level, so each inode remembers a few runs of
+// file blocks that sit in consecutive disk blocks. A block
+// stays mapped until itrunc(), so the runs never go stale.
+
+// Allocate a block for inode ip. A file's blocks go right
+// after the one it allocated last, and its first block at the
+// start of a stretch of the data area picked by its inode
+// number, so that files grow in runs of consecutive blocks.
+static uint
+iballoc(struct inode *ip)
+{
+  uint goal;
+
+  if(ip->lastblock)
+    goal = ip->lastblock + 1;
+  else
+    goal = sb.size - sb.nblocks + ip->inum * (sb.nblocks / sb.ninodes);
+  ip->lastblock = balloc(ip->dev, goal);
+  return ip->lastblock;
+}
+
+// Return the cached disk address of file block bn, or 0.
+static uint
+runlookup(struct inode *ip, uint bn)
+{
+  struct maprun *r;
+
+  for(r = ip->runs; r < &ip->runs[NMAPRUN]; r++)
+    if(r->len && bn - r->bn < r->len)
+      return r->addr + (bn - r->bn);
+  return 0;
+}
+
+// Remember that file blocks bn..bn+len-1 are at disk blocks
+// addr..addr+len-1, growing a run that this one continues.
+static void
+runadd(struct inode *ip, uint bn, uint addr, uint len)
+{
+  struct maprun *r;
+
+  for(r = ip->runs; r < &ip->runs[NMAPRUN]; r++){
+    if(r->len && r->bn + r->len == bn && r->addr + r->len == addr){
+      r->len += len;
+      return;
+    }
+  }
+  r = &ip->runs[ip->nextrun++ % NMAPRUN];
+  r->bn = bn;
+  r->addr = addr;
+  r->len = len;
+}
+
+// Return the block in slot i of indirect block bp, which maps
+// file block bn, allocating it if necessary. Caches the run of
+// consecutive blocks that starts there.
+static uint
+mapslot(struct inode *ip, struct buf *bp, uint i, uint bn)
+{
+  uint addr, n, *a;
+
+  a = (uint*)bp->data;
+  if((addr = a[i]) == 0){
+    a[i] = addr = iballoc(ip);
+    log_write(bp);
+    runadd(ip, bn, addr, 1);
+    return addr;
+  }
+  for(n = 1; i + n < NINDIRECT && a[i+n] == addr + n; n++)
+    ;
+  runadd(ip, bn, addr, n);
+  return addr;
+}
 
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
 static uint
 bmap(struct inode *ip, uint bn)
 {
-  uint addr, *a;
+  uint addr, fbn, *a;
   struct buf *bp;
 
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = iballoc(ip);
     return addr;
   }
+  if((addr = runlookup(ip, bn)) != 0)
+    return addr;
+  fbn = bn;
   bn -= NDIRECT;
 
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+      ip->addrs[NDIRECT] = addr = iballoc(ip);
+    bp = bread(ip->dev, addr);
+    addr = mapslot(ip, bp, bn, fbn);
+    brelse(bp);
+    return addr;
+  }
+  bn -= NINDIRECT;
+
+  if(bn < NDINDIRECT){
+    // Load double-indirect block, then the indirect block
+    // it lists, allocating each if necessary.
+    if((addr = ip->addrs[NDIRECT+1]) == 0)
+      ip->addrs[NDIRECT+1] = addr = iballoc(ip);
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+    if((addr = a[bn / NINDIRECT]) == 0){
+      a[bn / NINDIRECT] = addr = iballoc(ip);
       log_write(bp);
     }
     brelse(bp);
+    bp = bread(ip->dev, addr);
+    addr = mapslot(ip, bp, bn % NINDIRECT, fbn);
+    brelse(bp);
     return addr;
   }
 
@@ -408,8 +719,8 @@ static void
 itrunc(struct inode *ip)
 {
   int i, j;
-  struct buf *bp;
-  uint *a;
+  struct buf *bp, *bp2;
+  uint *a, *a2;
 
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
@@ -430,6 +741,28 @@ itrunc(struct inode *ip)
     ip->addrs[NDIRECT] = 0;
   }
 
+  if(ip->addrs[NDIRECT+1]){
+    bp = bread(ip->dev, ip->addrs[NDIRECT+1]);
+    a = (uint*)bp->data;
+    for(i = 0; i < NINDIRECT; i++){
+      if(a[i] == 0)
+        continue;
+      bp2 = bread(ip->dev, a[i]);
+      a2 = (uint*)bp2->data;
+      for(j = 0; j < NINDIRECT; j++){
+        if(a2[j])
+          bfree(ip->dev, a2[j]);
+      }
+      brelse(bp2);
+      bfree(ip->dev, a[i]);
+    }
+    brelse(bp);
+    bfree(ip->dev, ip->addrs[NDIRECT+1]);
+    ip->addrs[NDIRECT+1] = 0;
+  }
+
+  memset(ip->runs, 0, sizeof(ip->runs));
+  ip->lastblock = 0;
   ip->size = 0;
   iupdate(ip);
 }
@@ -475,6 +808,36 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   return n;
 }
 
+// Read data from inode straight from the buffer cache into
+// pipe p, as much as p takes without waiting.
+// Caller must hold ip->lock.
+int
+readipipe(struct inode *ip, uint off, uint n, struct pipe *p)
+{
+  uint tot, m;
+  int r;
+  struct buf *bp;
+
+  if(ip->type == T_DEV)
+    return -1;
+  if(off > ip->size || off + n < off)
+    return -1;
+  if(off + n > ip->size)
+    n = ip->size - off;
+
+  for(tot=0; tot<n; tot+=m, off+=m){
+    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    m = min(n - tot, BSIZE - off%BSIZE);
+    r = pipeput(p, (char*)bp->data + off%BSIZE, m);
+    brelse(bp);
+    if(r < 0)
+      return tot > 0 ? tot : -1;
+    if(r < m)
+      return tot + r;
+  }
+  return n;
+}
+
 // PAGEBREAK!
 // Write data to inode.
 // Caller must hold ip->lock.
@@ -492,7 +855,8 @@ writei(struct inode *ip, char *src, uint off, uint n)
 
   if(off > ip->size || off + n < off)
     return -1;
-  if(off + n > MAXFILE*BSIZE)
+  // In blocks: MAXFILE*BSIZE overflows a uint for big blocks.
+  if((off + n)/BSIZE + ((off + n)%BSIZE != 0) > MAXFILE)
     return -1;
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
@@ -519,6 +883,393 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Directory name cache.
+//
+// Remembers the result of recent dirlookup() calls as
+// (directory, name) -> (inum, offset), with inum 0 for names
+// that are not there. The cache is DCWAYS-way set associative.
+//
+// A directory's entries are only looked up, added or
+// removed with the directory locked, so the cache stays in
+// step with the disk as long as dirlink() and dirunlink()
+// update it. dcache.lock serializes writers; readers take no
+// lock but check an entry's seq, which is odd while a writer
+// is changing it, and retry as a miss if it moved.
+#define DCWAYS 4
+
+struct dcentry {
+  uint seq;
+  uint dev;
+  uint dir;            // directory inum, 0 if unused
+  uint inum;           // 0 for a negative entry
+  uint off;
+  char name[DIRSIZ];
+};
+
+struct {
+  struct spinlock lock;
+  struct dcentry entry[NDCACHE];
+  uint hand[NDCACHE/DCWAYS];  // next way to replace per set
+} dcache;
+
+static void
+dcinit(void)
+{
+  initlock(&dcache.lock, "dcache");
+}
+
+static struct dcentry*
+dcset(uint dir, char *name)
+{
+  uint h;
+  int i;
+
+  h = dir;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h*31 + name[i];
+  return &dcache.entry[(h % (NDCACHE/DCWAYS)) * DCWAYS];
+}
+
+// Look up name in directory dp without locking.
+// Returns 1 and fills *inum and *off on a hit.
+static int
+dcget(struct inode *dp, char *name, uint *inum, uint *off)
+{
+  struct dcentry *e, *set;
+  uint seq, hit;
+
+  set = dcset(dp->inum, name);
+  for(e = set; e < set + DCWAYS; e++){
+    seq = e->seq;
+    if(seq & 1)
+      continue;
+    __sync_synchronize();
+    hit = e->dir == dp->inum && e->dev == dp->dev &&
+          namecmp(e->name, name) == 0;
+    *inum = e->inum;
+    *off = e->off;
+    __sync_synchronize();
+    if(hit && e->seq == seq)
+      return 1;
+  }
+  return 0;
+}
+
+// Enter (dp, name) -> (inum, off) into the cache,
+// replacing any entry for the same name.
+static void
+dcput(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dcentry *e, *set;
+
+  set = dcset(dp->inum, name);
+  acquire(&dcache.lock);
+  for(e = set; e < set + DCWAYS; e++)
+    if(e->dir == dp->inum && e->dev == dp->dev && namecmp(e->name, name) == 0)
+      break;
+  if(e == set + DCWAYS)
+    e = set + dcache.hand[(set - dcache.entry) / DCWAYS]++ % DCWAYS;
+  e->seq++;
+  __sync_synchronize();
+  e->dev = dp->dev;
+  e->dir = dp->inum;
+  e->inum = inum;
+  e->off = off;
+  strncpy(e->name, name, DIRSIZ);
+  __sync_synchronize();
+  e->seq++;
+  release(&dcache.lock);
+}
+
+// Drop every entry of directory dir, which is being freed.
+static void
+dcpurge(uint dev, uint dir)
+{
+  struct dcentry *e;
+
+  acquire(&dcache.lock);
+  for(e = dcache.entry; e < &dcache.entry[NDCACHE]; e++){
+    if(e->dir == dir && e->dev == dev){
+      e->seq++;
+      __sync_synchronize();
+      e->dir = 0;
+      __sync_synchronize();
+      e->seq++;
+    }
+  }
+  release(&dcache.lock);
+}
+
+// Hashed directories.
+// Caller must hold dp->lock, and the buf of block 0 while
+// using the index in it.
+
+static uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = (h ^ (uchar)name[i]) * 16777619;
+  return h;
+}
+
+static struct buf*
+dirblock(struct inode *dp, uint bn)
+{
+  return bread(dp->dev, bmap(dp, bn));
+}
+
+// Return block 0 of dp if dp is a hashed directory.
+static struct buf*
+hopen(struct inode *dp)
+{
+  struct buf *b0;
+  struct dirhead *h;
+
+  if(dp->size <= BSIZE)
+    return 0;
+  b0 = dirblock(dp, 0);
+  h = (struct dirhead*)b0->data;
+  if(h->inum == 0 && h->magic == DIRMAGIC)
+    return b0;
+  brelse(b0);
+  return 0;
+}
+
+static ushort*
+hmap(struct buf *b0, uint i)
+{
+  return &((struct dirmap*)b0->data + 3 + i/7)->leaf[i%7];
+}
+
+// Leaf block for hash h.
+static uint
+hleaf(struct buf *b0, uint h)
+{
+  return *hmap(b0, h & ((1 << ((struct dirhead*)b0->data)->depth) - 1));
+}
+
+// Append a new empty leaf block to dp.
+// Returns it locked, and its block number in *bn.
+static struct buf*
+hnewleaf(struct inode *dp, uint depth, uint *bn)
+{
+  struct buf *bp;
+  struct dirhead *h;
+
+  *bn = dp->size / BSIZE;
+  if(*bn > 0xffff)
+    panic("hnewleaf: directory too big");
+  bp = dirblock(dp, *bn);
+  h = (struct dirhead*)bp->data;
+  h->magic = DIRMAGIC;
+  h->depth = depth;
+  log_write(bp);
+  dp->size += BSIZE;
+  iupdate(dp);
+  return bp;
+}
+
+static uint
+hlookup(struct inode *dp, struct buf *b0, char *name, uint *poff)
+{
+  struct buf *bp;
+  struct dirent *de;
+  uint bn, next, inum;
+  int i;
+
+  *poff = 0;
+  de = (struct dirent*)b0->data;
+  for(i = 1; i < 3; i++){
+    if(namecmp(name, de[i].name) == 0){
+      *poff = i * sizeof(*de);
+      return de[i].inum;
+    }
+  }
+
+  for(bn = hleaf(b0, dirhash(name)); bn; bn = next){
+    bp = dirblock(dp, bn);
+    de = (struct dirent*)bp->data;
+    for(i = 1; i < DPB; i++){
+      if(de[i].inum && namecmp(name, de[i].name) == 0){
+        *poff = bn*BSIZE + i*sizeof(*de);
+        inum = de[i].inum;
+        brelse(bp);
+        return inum;
+      }
+    }
+    next = ((struct dirhead*)bp->data)->next;
+    brelse(bp);
+  }
+  return 0;
+}
+
+// Put (name, inum) in a free slot of its leaf chain.
+// Returns its offset, or -1 if the chain is full.
+static int
+hinsert(struct inode *dp, struct buf *b0, char *name, uint inum)
+{
+  struct buf *bp;
+  struct dirent *de;
+  uint bn, next;
+  int i;
+
+  for(bn = hleaf(b0, dirhash(name)); bn; bn = next){
+    bp = dirblock(dp, bn);
+    de = (struct dirent*)bp->data;
+    for(i = 1; i < DPB; i++){
+      if(de[i].inum == 0){
+        strncpy(de[i].name, name, DIRSIZ);
+        de[i].inum = inum;
+        log_write(bp);
+        brelse(bp);
+        return bn*BSIZE + i*sizeof(*de);
+      }
+    }
+    next = ((struct dirhead*)bp->data)->next;
+    brelse(bp);
+  }
+  return -1;
+}
+
+// Split the leaf that hash h maps to, doubling the map
+// first if the leaf uses all of its bits.
+// Returns 0 if the leaf cannot be split.
+static int
+hsplit(struct inode *dp, struct buf *b0, uint h)
+{
+  struct buf *bp, *np;
+  struct dirhead *head, *lh;
+  struct dirent *de, *nde;
+  uint bn, nbn, d, i, j;
+
+  head = (struct dirhead*)b0->data;
+  bn = hleaf(b0, h);
+  bp = dirblock(dp, bn);
+  lh = (struct dirhead*)bp->data;
+  d = lh->depth;
+  if(lh->next || (d == head->depth && (2 << d) > DIRMAPSZ)){
+    brelse(bp);
+    return 0;
+  }
+  if(d == head->depth){
+    for(i = 0; i < (1 << d); i++)
+      *hmap(b0, i + (1 << d)) = *hmap(b0, i);
+    head->depth++;
+  }
+
+  np = hnewleaf(dp, d + 1, &nbn);
+  lh->depth = d + 1;
+  de = (struct dirent*)bp->data;
+  nde = (struct dirent*)np->data;
+  for(i = j = 1; i < DPB; i++){
+    if(de[i].inum && (dirhash(de[i].name) >> d) & 1){
+      nde[j++] = de[i];
+      memset(&de[i], 0, sizeof(de[i]));
+    }
+  }
+  for(i = 0; i < (1 << head->depth); i++)
+    if(*hmap(b0, i) == bn && (i >> d) & 1)
+      *hmap(b0, i) = nbn;
+
+  log_write(np);
+  log_write(bp);
+  log_write(b0);
+  brelse(np);
+  brelse(bp);
+  dcpurge(dp->dev, dp->inum);  // entries moved
+  return 1;
+}
+
+// Add (name, inum) to hashed directory dp.
+// Returns the offset of the new entry.
+static int
+hlink(struct inode *dp, struct buf *b0, char *name, uint inum)
+{
+  struct buf *bp, *np;
+  struct dirhead *lh;
+  struct dirent *de;
+  uint bn, nbn;
+  int off;
+
+  if((off = hinsert(dp, b0, name, inum)) >= 0)
+    return off;
+  if(hsplit(dp, b0, dirhash(name)) && (off = hinsert(dp, b0, name, inum)) >= 0)
+    return off;
+
+  // Still full: chain an overflow block to the leaf.
+  bn = hleaf(b0, dirhash(name));
+  for(;;){
+    bp = dirblock(dp, bn);
+    lh = (struct dirhead*)bp->data;
+    if(lh->next == 0)
+      break;
+    bn = lh->next;
+    brelse(bp);
+  }
+  np = hnewleaf(dp, lh->depth, &nbn);
+  lh->next = nbn;
+  log_write(bp);
+  brelse(bp);
+  de = (struct dirent*)np->data;
+  strncpy(de[1].name, name, DIRSIZ);
+  de[1].inum = inum;
+  log_write(np);
+  brelse(np);
+  return nbn*BSIZE + sizeof(*de);
+}
+
+// Turn dp, a linear directory with one full block,
+// into a hashed directory with two leaves.
+// Returns its block 0, locked.
+static struct buf*
+hconvert(struct inode *dp)
+{
+  struct buf *b0, *lp[2];
+  struct dirhead *head;
+  struct dirent *de, dot[2], *lde;
+  uint bn[2], n[2], i, l;
+
+  b0 = dirblock(dp, 0);
+  lp[0] = hnewleaf(dp, 1, &bn[0]);
+  lp[1] = hnewleaf(dp, 1, &bn[1]);
+  n[0] = n[1] = 1;
+  memset(dot, 0, sizeof(dot));
+  de = (struct dirent*)b0->data;
+  for(i = 0; i < DPB; i++){
+    if(de[i].inum == 0)
+      continue;
+    if(namecmp(de[i].name, ".") == 0)
+      dot[0] = de[i];
+    else if(namecmp(de[i].name, "..") == 0)
+      dot[1] = de[i];
+    else {
+      l = dirhash(de[i].name) & 1;
+      lde = (struct dirent*)lp[l]->data;
+      lde[n[l]++] = de[i];
+    }
+  }
+
+  memset(b0->data, 0, BSIZE);
+  head = (struct dirhead*)b0->data;
+  head->magic = DIRMAGIC;
+  head->depth = 1;
+  de[1] = dot[0];
+  de[2] = dot[1];
+  *hmap(b0, 0) = bn[0];
+  *hmap(b0, 1) = bn[1];
+  for(l = 0; l < 2; l++){
+    log_write(lp[l]);
+    brelse(lp[l]);
+  }
+  log_write(b0);
+  dcpurge(dp->dev, dp->inum);  // entries moved
+  return b0;
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode*
@@ -526,10 +1277,30 @@ dirlookup(struct inode *dp, char *name, uint *poff)
 {
   uint off, inum;
   struct dirent de;
+  struct buf *b0;
 
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
+  if(dcget(dp, name, &inum, &off)){
+    if(inum == 0)
+      return 0;
+    if(poff)
+      *poff = off;
+    return iget(dp->dev, inum);
+  }
+
+  if((b0 = hopen(dp)) != 0){
+    inum = hlookup(dp, b0, name, &off);
+    brelse(b0);
+    dcput(dp, name, inum, off);
+    if(inum == 0)
+      return 0;
+    if(poff)
+      *poff = off;
+    return iget(dp->dev, inum);
+  }
+
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlookup read");
@@ -540,10 +1311,12 @@ dirlookup(struct inode *dp, char *name, uint *poff)
       if(poff)
         *poff = off;
       inum = de.inum;
+      dcput(dp, name, inum, off);
       return iget(dp->dev, inum);
     }
   }
 
+  dcput(dp, name, 0, 0);
   return 0;
 }
 
@@ -554,6 +1327,7 @@ dirlink(struct inode *dp, char *name, uint inum)
   int off;
   struct dirent de;
   struct inode *ip;
+  struct buf *b0;
 
   // Check that name is not present.
   if((ip = dirlookup(dp, name, 0)) != 0){
@@ -561,6 +1335,13 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
+  if((b0 = hopen(dp)) != 0){
+    off = hlink(dp, b0, name, inum);
+    brelse(b0);
+    dcput(dp, name, inum, off);
+    return 0;
+  }
+
   // Look for an empty dirent.
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
@@ -569,14 +1350,37 @@ dirlink(struct inode *dp, char *name, uint inum)
       break;
   }
 
+  // A full one-block directory becomes hashed.
+  if(off == BSIZE && dp->size == BSIZE){
+    b0 = hconvert(dp);
+    off = hlink(dp, b0, name, inum);
+    brelse(b0);
+    dcput(dp, name, inum, off);
+    return 0;
+  }
+
   strncpy(de.name, name, DIRSIZ);
   de.inum = inum;
   if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
     panic("dirlink");
+  dcput(dp, name, inum, off);
 
   return 0;
 }
 
+// Remove the entry for name, found at byte offset off,
+// from the directory dp.
+void
+dirunlink(struct inode *dp, char *name, uint off)
+{
+  struct dirent de;
+
+  memset(&de, 0, sizeof(de));
+  if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+    panic("unlink: writei");
+  dcput(dp, name, 0, 0);
+}
+
 //PAGEBREAK!
 // Paths
 
@@ -3,7 +3,9 @@
 
 
 #define ROOTINO 1  // root i-number
-#define BSIZE 512  // block size
+#ifndef BSIZE
+#define BSIZE 512  // block size: 512, 1024, 2048 or 4096
+#endif
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
@@ -19,11 +21,21 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint bsize;        // Block size in bytes
+  uint flags;        // SB_* options
 };
 
-#define NDIRECT 12
+#define SB_DELAYED 0x1   // end_op() does not wait for the commit
+
+// Blocks holding a log header for n blocks: a count, then one
+// block number per block. A log of nlog blocks starts with
+// LOGHEAD(nlog) header blocks, so it holds nlog - LOGHEAD(nlog).
+#define LOGHEAD(n) ((((n) + 1) * sizeof(uint) + BSIZE - 1) / BSIZE)
+
+#define NDIRECT 11
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NDINDIRECT (NINDIRECT * NINDIRECT)
+#define MAXFILE (NDIRECT + NINDIRECT + NDINDIRECT)
 
 // On-disk inode structure
 struct dinode {
@@ -32,7 +44,7 @@ struct dinode {
   short minor;          // Minor device number (T_DEV only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  uint addrs[NDIRECT+2];   // Data block addresses
 };
 
 // Inodes per block.
@@ -41,12 +53,18 @@ struct dinode {
 // Block containing inode i
 #define IBLOCK(i, sb)     ((i) / IPB + sb.inodestart)
 
+// Inode blocks on disk
+#define IBLOCKS       (NINODES / IPB + 1)
+
 // Bitmap bits per block
 #define BPB           (BSIZE*8)
 
 // Block of free map containing bit for block b
 #define BBLOCK(b, sb) (b/BPB + sb.bmapstart)
 
+// Free map blocks on disk
+#define BMAPBLOCKS    (FSSIZE/BPB + 1)
+
 // Directory is a file containing a sequence of dirent structures.
 #define DIRSIZ 14
 
@@ -55,3 +73,32 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// Dirents per block
+#define DPB           (BSIZE / sizeof(struct dirent))
+
+// A directory that outgrows its first block becomes a hashed
+// directory, indexed by extendible hashing on dirhash() of the
+// names. Its blocks are still arrays of dirents, so it can be
+// read like any other directory; the index lives in slots
+// whose inum is 0.
+//   block 0: a dirhead, "." and "..", and then dirmap slots
+//            giving the leaf block for each value of the low
+//            depth bits of a hash.
+//   leaves:  a dirhead and DPB-1 entries. A full leaf that
+//            cannot be split grows a chain of overflow blocks.
+#define DIRMAGIC      0x6864
+#define DIRMAPSZ      ((DPB - 3) * 7)  // leaf map entries in block 0
+
+struct dirhead {
+  ushort inum;          // always 0
+  ushort magic;         // DIRMAGIC
+  ushort depth;         // hash bits used by the map, or by the leaf
+  ushort next;          // next block of a leaf's chain, or 0
+  uint pad[2];
+};
+
+struct dirmap {
+  ushort inum;          // always 0
+  ushort leaf[7];
+};
+
@@ -12,6 +12,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 #define SECTOR_SIZE   512
 #define IDE_BSY       0x80
@@ -23,6 +24,9 @@
 #define IDE_CMD_WRITE 0x30
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
+#define IDE_CMD_SETMUL 0xc6
+
+#define SECTOR_PER_BLOCK (BSIZE/SECTOR_SIZE)
 
 // idequeue points to the buf now being read/written to the disk.
 // idequeue->qnext points to the next buf to be processed.
@@ -33,6 +37,7 @@ static struct buf *idequeue;
 
 static int havedisk1;
 static void idestart(struct buf*);
+static void idesetmul(int);
 
 // Wait for IDE disk to become ready.
 static int
@@ -67,6 +72,26 @@ ideinit(void)
 
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
+
+  // Move a whole block per interrupt.
+  if(SECTOR_PER_BLOCK > 1){
+    idesetmul(0);
+    if(havedisk1)
+      idesetmul(1);
+  }
+}
+
+// Set the number of sectors disk dev moves per interrupt
+// with IDE_CMD_RDMUL and IDE_CMD_WRMUL to a block's worth.
+static void
+idesetmul(int dev)
+{
+  outb(0x3f6, 2);  // no interrupt
+  outb(0x1f2, SECTOR_PER_BLOCK);
+  outb(0x1f6, 0xe0 | (dev<<4));
+  outb(0x1f7, IDE_CMD_SETMUL);
+  if(idewait(1) < 0)
+    panic("idesetmul");
 }
 
 // Start the request for b.  Caller must hold idelock.
@@ -77,13 +102,14 @@ idestart(struct buf *b)
     panic("idestart");
   if(b->blockno >= FSSIZE)
     panic("incorrect blockno");
-  int sector_per_block =  BSIZE/SECTOR_SIZE;
+  int sector_per_block =  SECTOR_PER_BLOCK;
   int sector = b->blockno * sector_per_block;
   int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
   int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
-  if (sector_per_block > 7) panic("idestart");
+  if (sector_per_block > 16) panic("idestart");
 
+  TRACE(TR_IDESTART, b->blockno, (b->flags & B_DIRTY) != 0);
   idewait(0);
   outb(0x3f6, 0);  // generate interrupt
   outb(0x1f2, sector_per_block);  // number of sectors
@@ -121,6 +147,7 @@ ideintr(void)
   // Wake process waiting for this buf.
   b->flags |= B_VALID;
   b->flags &= ~B_DIRTY;
+  TRACE(TR_IDEDONE, b->blockno, 0);
   wakeup(b);
 
   // Start disk on next buf in queue.
@@ -130,6 +157,17 @@ ideintr(void)
   release(&idelock);
 }
 
+// Charge a read of b to the current process. Writes are
+// charged by log_write(), since the committer does them.
+static void
+idecharge(struct buf *b)
+{
+  struct proc *p = myproc();
+
+  if(p && !(b->flags & B_DIRTY))
+    p->ru.inblock++;
+}
+
 //PAGEBREAK!
 // Sync buf with disk.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
@@ -145,6 +183,7 @@ iderw(struct buf *b)
     panic("iderw: nothing to do");
   if(b->dev != 0 && !havedisk1)
     panic("iderw: ide disk 1 not present");
+  idecharge(b);
 
   acquire(&idelock);  //DOC:acquire-lock
 
@@ -164,5 +203,54 @@ iderw(struct buf *b)
   }
 
 
+  release(&idelock);
+}
+
+// Sync a batch of bufs with disk.
+// All n requests are queued at once, so ideintr() starts
+// each one as soon as the previous finishes instead of the
+// disk idling while the caller wakes up and queues the next.
+// Returns when every buf in the batch is done.
+void
+iderwv(struct buf **bs, int n)
+{
+  struct buf **pp;
+  int i, idle;
+
+  if(n <= 0)
+    return;
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bs[i]->lock))
+      panic("iderwv: buf not locked");
+    if((bs[i]->flags & (B_VALID|B_DIRTY)) == B_VALID)
+      panic("iderwv: nothing to do");
+    if(bs[i]->dev != 0 && !havedisk1)
+      panic("iderwv: ide disk 1 not present");
+    idecharge(bs[i]);
+  }
+
+  acquire(&idelock);
+
+  // Append the whole batch to idequeue.
+  idle = (idequeue == 0);
+  for(pp=&idequeue; *pp; pp=&(*pp)->qnext)
+    ;
+  for(i = 0; i < n; i++){
+    bs[i]->qnext = 0;
+    *pp = bs[i];
+    pp = &bs[i]->qnext;
+  }
+
+  // Start disk if necessary.
+  if(idle)
+    idestart(idequeue);
+
+  // Requests finish in queue order, so waiting for
+  // each in turn sleeps at most once per buf.
+  for(i = 0; i < n; i++){
+    while((bs[i]->flags & (B_VALID|B_DIRTY)) != B_VALID)
+      sleep(bs[i], &idelock);
+  }
+
   release(&idelock);
 }
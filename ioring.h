@@ -0,0 +1,41 @@
+// Submission and completion rings for ioring_enter().
+//
+// The process fills in sq[sqtail % IORING_SQSIZE] and bumps
+// sqtail; ioring_enter() runs the requests from sqhead on,
+// bumping sqhead, and posts a completion for each one at
+// cq[cqtail % IORING_CQSIZE]. The process reads completions
+// from cqhead on without entering the kernel.
+
+#define IORING_SQSIZE 32
+#define IORING_CQSIZE 64
+
+// Operations
+#define IORING_OP_NOP    0
+#define IORING_OP_READ   1
+#define IORING_OP_WRITE  2
+#define IORING_OP_OPEN   3
+#define IORING_OP_CLOSE  4
+#define IORING_OP_FSYNC  5
+
+struct io_sqe {
+  int op;           // IORING_OP_*
+  int fd;
+  char *addr;       // buffer, or path for OPEN
+  int len;          // buffer length, or mode for OPEN
+  int off;          // file offset, or -1 to use and move the fd's
+  int data;         // copied to the completion
+};
+
+struct io_cqe {
+  int data;         // from the request
+  int res;          // what the matching system call would return
+};
+
+struct io_ring {
+  uint sqhead;      // next request the kernel takes
+  uint sqtail;      // next free request slot
+  uint cqhead;      // next completion the process takes
+  uint cqtail;      // next free completion slot
+  struct io_sqe sq[IORING_SQSIZE];
+  struct io_cqe cq[IORING_CQSIZE];
+};
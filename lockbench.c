@@ -0,0 +1,57 @@
+// Spinlock contention: N processes each make M uptime()
+// calls, which all take tickslock. Prints how long each
+// process took; with a fair lock they finish close together.
+// Usage: lockbench [N [M]]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n, m, t, fds[2];
+  int start, d, min, max;
+
+  n = 4;
+  m = 200000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(argc > 2)
+    m = atoi(argv[2]);
+  if(pipe(fds) < 0){
+    printf(2, "lockbench: pipe failed\n");
+    exit();
+  }
+
+  start = uptime();
+  for(i = 0; i < n; i++){
+    if((t = fork()) < 0){
+      printf(2, "lockbench: fork failed\n");
+      break;
+    }
+    if(t == 0){
+      close(fds[0]);
+      for(j = 0; j < m; j++)
+        uptime();
+      d = uptime() - start;
+      write(fds[1], &d, sizeof(d));
+      exit();
+    }
+  }
+  n = i;
+  close(fds[1]);
+
+  min = max = -1;
+  for(i = 0; i < n && read(fds[0], &d, sizeof(d)) == sizeof(d); i++){
+    if(min < 0 || d < min)
+      min = d;
+    if(d > max)
+      max = d;
+  }
+  for(i = 0; i < n; i++)
+    wait();
+  printf(1, "lockbench: %d procs x %d calls: first done after %d ticks, last after %d\n",
+         n, m, min, max);
+  exit();
+}
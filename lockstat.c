@@ -0,0 +1,58 @@
+// Print the lock statistics of a kernel built with
+// LOCKSTAT=TRUE, busiest waits first.
+// Usage: lockstat [-r]       print, and with -r reset after
+//        lockstat cmd args   reset, run cmd, then print
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "lockstat.h"
+
+struct lockstat ls[NLOCKCLASS];
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n, reset;
+  struct lockstat t;
+
+  reset = argc > 1 && strcmp(argv[1], "-r") == 0;
+  if(argc > 1 && !reset){
+    if(lockstat(ls, 0, 1) < 0){
+      printf(2, "lockstat: kernel built without LOCKSTAT\n");
+      exit();
+    }
+    if((i = fork()) < 0){
+      printf(2, "lockstat: fork failed\n");
+      exit();
+    }
+    if(i == 0){
+      exec(argv[1], argv + 1);
+      printf(2, "lockstat: exec %s failed\n", argv[1]);
+      exit();
+    }
+    wait();
+  }
+
+  if((n = lockstat(ls, NLOCKCLASS, reset)) < 0){
+    printf(2, "lockstat: kernel built without LOCKSTAT\n");
+    exit();
+  }
+  for(i = 1; i < n; i++){
+    t = ls[i];
+    for(j = i; j > 0 && ls[j-1].kwait < t.kwait; j--)
+      ls[j] = ls[j-1];
+    ls[j] = t;
+  }
+  printf(1, "name             type  acquired  contended  wait-kcyc  hold-kcyc  maxhold\n");
+  for(i = 0; i < n; i++){
+    if(ls[i].nacq == 0)
+      continue;
+    printf(1, "%s", ls[i].name);
+    for(j = strlen(ls[i].name); j < 17; j++)
+      printf(1, " ");
+    printf(1, "%s  %d  %d  %d  %d  %d\n", ls[i].sleep ? "sleep" : "spin ",
+      ls[i].nacq, ls[i].ncont, ls[i].kwait, ls[i].khold, ls[i].maxhold);
+  }
+  exit();
+}
@@ -0,0 +1,16 @@
+// Lock statistics, kept per lock name when the kernel is
+// built with LOCKSTAT=TRUE and read with the lockstat system
+// call. Times are TSC cycles; the totals are in units of
+// 1024 cycles so they fit in a uint.
+#define LSNAME      16  // longest lock name kept
+#define NLOCKCLASS  64  // most lock names kept
+
+struct lockstat {
+  char name[LSNAME];
+  int sleep;      // sleeplocks, rather than spinlocks
+  uint nacq;      // acquisitions
+  uint ncont;     // acquisitions that had to wait
+  uint kwait;     // time spent waiting, in 1024 cycles
+  uint khold;     // time held, in 1024 cycles
+  uint maxhold;   // longest hold, in cycles
+};
@@ -1,24 +1,46 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "mmu.h"
+#include "proc.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
 
-// Simple logging that allows concurrent FS system calls.
+// Group-committing log that allows concurrent FS system calls.
 //
 // A log transaction contains the updates of multiple FS system
-// calls. The logging system only commits when there are
-// no FS system calls active. Thus there is never
-// any reasoning required about whether a commit might
-// write an uncommitted system call's updates to disk.
+// calls. A dedicated kernel process, the committer, commits
+// transactions. It seals the open transaction only once no FS
+// system call is active in it, so there is never any reasoning
+// required about whether a commit might write an uncommitted
+// system call's updates to disk.
+//
+// Sealing copies the transaction's blocks into the log's own
+// buffers. From then on new system calls run in the next
+// transaction while the committer writes, commits and installs
+// the copy, so the in-memory log is double-buffered: one
+// transaction filling up, one on its way to disk. Every system
+// call that finishes while a commit is in progress is grouped
+// into the next one.
+//
+// If the superblock has SB_DELAYED (mkfs -d), end_op()
+// does not wait: the open transaction is committed once
+// it is COMMITTICKS old, when the log fills up, or when
+// log_force() (fsync) asks for it. A crash loses at most the last few
+// transactions, each of them entirely.
 //
 // A system call should call begin_op()/end_op() to mark
 // its start and end. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
-// But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// It reserves log space for the blocks the system call
+// declared it may write: begin_opn(n) reserves n blocks,
+// begin_op() the MAXOPBLOCKS worst case.
+// If the log is close to running out, it asks for a
+// commit and sleeps until the open transaction
+// has been sealed. end_op() returns once the transaction
+// holding the system call's updates has committed.
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
@@ -29,8 +51,9 @@
 //   ...
 // Log appends are synchronous.
 
-// Contents of the header block, used for both the on-disk header block
+// Contents of the header, used for both the on-disk header blocks
 // and to keep track in memory of logged block# before commit.
+// On disk it runs on from one header block to the next.
 struct logheader {
   int n;
   int block[LOGSIZE];
@@ -39,171 +62,361 @@ struct logheader {
 struct log {
   struct spinlock lock;
   int start;
-  int size;
+  int head;        // header blocks, before the data blocks.
+  int size;        // data blocks the log can hold.
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int reserved;    // log blocks they have reserved.
+  int sealing;     // committer is sealing the open transaction, please wait.
+  int commitreq;   // the open transaction should be committed.
+  uint seq;        // id of the open transaction.
+  uint committed;  // id of the last committed transaction.
+  uint opened;     // tick at which the open transaction got its first block.
+  int delayed;     // SB_DELAYED: end_op() does not wait for the commit.
   int dev;
-  struct logheader lh;
+  struct logheader lh;  // the open transaction
+
+  // Used only by the committer (and by recovery at boot).
+  struct logheader clh;          // the transaction being committed
+  struct buf *pin[LOGSIZE];      // its pinned blocks in the cache
+  struct buf *batch[LOGSIZE];    // requests handed to iderwv()
+  struct buf hbuf[LOGHEAD(LOGSIZE)];  // header blocks in use
+  struct buf lbuf[LOGSIZE];      // copy of its blocks
 };
 struct log log;
 
 static void recover_from_log(void);
-static void commit();
+static void committer(void);
 
 void
 initlog(int dev)
 {
-  if (sizeof(struct logheader) >= BSIZE)
-    panic("initlog: too big logheader");
+  int i;
 
   struct superblock sb;
   initlock(&log.lock, "log");
   readsb(dev, &sb);
   log.start = sb.logstart;
-  log.size = sb.nlog;
+  log.head = LOGHEAD(sb.nlog);
+  log.size = sb.nlog - log.head;
+  if (log.size > LOGSIZE)
+    log.size = LOGSIZE;
+  if (log.size < MAXWRITEBLOCKS)
+    panic("initlog: log too small");
+  log.delayed = (sb.flags & SB_DELAYED) != 0;
   log.dev = dev;
+  log.seq = 1;
+  log.committed = 0;
+  for (i = 0; i < LOGHEAD(LOGSIZE); i++) {
+    initsleeplock(&log.hbuf[i].lock, "loghead");
+    log.hbuf[i].dev = dev;
+  }
+  for (i = 0; i < LOGSIZE; i++) {
+    initsleeplock(&log.lbuf[i].lock, "logblock");
+    log.lbuf[i].dev = dev;
+  }
   recover_from_log();
+  if (kthread("logcommit", committer) < 0)
+    panic("initlog: no committer");
+}
+
+// Lock the log's own buffers, so that the caller can pass them to iderw().
+static void
+lockbufs(void)
+{
+  int i;
+
+  for (i = 0; i < LOGHEAD(LOGSIZE); i++)
+    acquiresleep(&log.hbuf[i].lock);
+  for (i = 0; i < LOGSIZE; i++)
+    acquiresleep(&log.lbuf[i].lock);
+}
+
+static void
+unlockbufs(void)
+{
+  int i;
+
+  for (i = 0; i < LOGHEAD(LOGSIZE); i++)
+    releasesleep(&log.hbuf[i].lock);
+  for (i = 0; i < LOGSIZE; i++)
+    releasesleep(&log.lbuf[i].lock);
+}
+
+// Read (flags 0) or write (B_DIRTY) the first n log buffers.
+// Buffer i goes to the log slot of block i, or to its home
+// location if home is set, all in one batch of disk requests.
+static void
+rwbufs(int n, int flags, int home)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    log.lbuf[i].blockno = home ? log.clh.block[i] : log.start+log.head+i;
+    log.lbuf[i].flags = flags;
+    log.batch[i] = &log.lbuf[i];
+  }
+  iderwv(log.batch, n);
 }
 
 // Copy committed blocks from log to their home location
 static void
 install_trans(void)
 {
-  int tail;
+  rwbufs(log.clh.n, B_DIRTY, 1);
+}
+
+// Copy the committing log header, which holds n blocks,
+// to (B_DIRTY) or from the header buffers.
+static void
+copyhead(int n, int flags)
+{
+  char *h = (char*)&log.clh;
+  int i, m;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    brelse(lbuf);
-    brelse(dbuf);
+  for (i = 0; i < LOGHEAD(n); i++) {
+    m = (n + 1) * sizeof(uint) - i*BSIZE;  // the last block may be partly used
+    if (m > BSIZE)
+      m = BSIZE;
+    if (flags & B_DIRTY)
+      memmove(log.hbuf[i].data, h + i*BSIZE, m);
+    else
+      memmove(h + i*BSIZE, log.hbuf[i].data, m);
   }
 }
 
-// Read the log header from disk into the in-memory log header
+// Read or write (B_DIRTY) header blocks from up to to.
 static void
-read_head(void)
+rwhead(int from, int to, int flags)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
   int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
+
+  for (i = from; i < to; i++) {
+    log.hbuf[i].blockno = log.start + i;
+    log.hbuf[i].flags = flags;
+    log.batch[i - from] = &log.hbuf[i];
   }
-  brelse(buf);
+  iderwv(log.batch, to - from);
+}
+
+// Read the log header from disk into the committing log header
+static void
+read_head(void)
+{
+  int n;
+
+  rwhead(0, 1, 0);
+  n = *(int*)log.hbuf[0].data;
+  if (n < 0 || n > log.size)
+    panic("read_head: log too big");
+  rwhead(1, LOGHEAD(n), 0);
+  copyhead(n, 0);
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
+// Write the committing log header to disk. The first block,
+// which holds n, goes last: writing it is the true point at
+// which the transaction commits.
 static void
 write_head(void)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *hb = (struct logheader *) (buf->data);
-  int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
-  }
-  bwrite(buf);
-  brelse(buf);
+  copyhead(log.clh.n, B_DIRTY);
+  rwhead(1, LOGHEAD(log.clh.n), B_DIRTY);
+  rwhead(0, 1, B_DIRTY);
 }
 
+// Runs before any FS system call, so the buffer
+// cache holds none of the blocks being installed.
 static void
 recover_from_log(void)
 {
+  lockbufs();
   read_head();
-  install_trans(); // if committed, copy from log to disk
-  log.lh.n = 0;
+  rwbufs(log.clh.n, 0, 0); // if committed, read the logged blocks
+  install_trans();         // and copy them to disk
+  log.clh.n = 0;
   write_head(); // clear the log
+  unlockbufs();
 }
 
-// called at the start of each FS system call.
+// called at the start of each FS system call that
+// writes at most n blocks.
 void
-begin_op(void)
+begin_opn(int n)
 {
+  if(n < 1 || n > log.size)
+    panic("begin_opn");
+
   acquire(&log.lock);
   while(1){
-    if(log.committing){
+    if(log.sealing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
-      // this op might exhaust log space; wait for commit.
+    } else if(log.lh.n + log.reserved + n > log.size){
+      // this op might exhaust log space; wait for the
+      // open transaction to be sealed.
+      log.commitreq = 1;
+      wakeup(&log.commitreq);
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
+      log.reserved += n;
+      myproc()->logblocks = n;
       release(&log.lock);
       break;
     }
   }
 }
 
+// called at the start of each FS system call.
+void
+begin_op(void)
+{
+  begin_opn(MAXOPBLOCKS);
+}
+
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// waits until the system call's transaction has committed.
 void
 end_op(void)
 {
-  int do_commit = 0;
+  uint id;
+  int dirty;
 
   acquire(&log.lock);
   log.outstanding -= 1;
-  if(log.committing)
-    panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
-    log.committing = 1;
+  log.reserved -= myproc()->logblocks;
+  myproc()->logblocks = 0;
+  id = log.seq;
+  // If delayed, logtick() or log_force() will commit it.
+  dirty = !log.delayed && log.lh.n > 0;
+  if(dirty){
+    log.commitreq = 1;
+    wakeup(&log.commitreq);
+  }
+  // the committer may be waiting for the transaction to drain,
+  // and begin_op() may be waiting for log space, and
+  // decrementing log.outstanding has decreased the amount
+  // of reserved space.
+  wakeup(&log);
+  while(dirty && log.committed < id)
+    sleep(&log.committed, &log.lock);
+  release(&log.lock);
+}
+
+// Commit everything written so far and wait until it is on disk.
+void
+log_force(void)
+{
+  uint id;
+
+  acquire(&log.lock);
+  if(log.lh.n > 0){
+    id = log.seq;
+    log.commitreq = 1;
+    wakeup(&log.commitreq);
   } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
+    id = log.seq - 1;  // may still be on its way to disk
   }
+  while(log.committed < id)
+    sleep(&log.committed, &log.lock);
   release(&log.lock);
+}
 
-  if(do_commit){
-    // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
-    commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
-    release(&log.lock);
+// Called by the timer interrupt on every tick.
+// Asks for the open transaction to be committed
+// once it has been collecting blocks for COMMITTICKS.
+void
+logtick(void)
+{
+  if(!log.delayed)
+    return;
+  acquire(&log.lock);
+  if(log.lh.n > 0 && !log.commitreq && ticks - log.opened >= COMMITTICKS){
+    log.commitreq = 1;
+    wakeup(&log.commitreq);
   }
+  release(&log.lock);
 }
 
-// Copy modified blocks from cache to log.
+// Copy the sealed transaction's blocks from the cache into
+// the log buffers. No system call is active, so none of
+// the blocks can change underneath us; they are pinned,
+// so bread() never has to go to the disk.
 static void
-write_log(void)
+snapshot(void)
 {
-  int tail;
+  struct buf *b;
+  int i;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  for (i = 0; i < log.clh.n; i++) {
+    b = bread(log.dev, log.clh.block[i]);
+    memmove(log.lbuf[i].data, b->data, BSIZE);
+    log.pin[i] = b;
+    brelse(b);
   }
 }
 
+// Write the sealed transaction to disk and wake up the
+// system calls waiting for transaction id to commit.
 static void
-commit()
+commit(uint id)
 {
-  if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
+  int i;
+
+  if (log.clh.n > 0) {
+    rwbufs(log.clh.n, B_DIRTY, 0); // Write modified blocks to log
     write_head();    // Write header to disk -- the real commit
+  }
+
+  acquire(&log.lock);
+  log.committed = id;
+  wakeup(&log.committed);
+  release(&log.lock);
+
+  if (log.clh.n > 0) {
     install_trans(); // Now install writes to home locations
-    log.lh.n = 0;
+    for (i = 0; i < log.clh.n; i++)
+      bunpin(log.pin[i]);
+    log.clh.n = 0;
     write_head();    // Erase the transaction from the log
   }
 }
 
+// The committer: seals the open transaction whenever a commit
+// has been requested, then lets the next transaction start
+// while it commits the sealed one. Never returns.
+static void
+committer(void)
+{
+  uint id;
+
+  lockbufs();
+  for(;;){
+    acquire(&log.lock);
+    while(!log.commitreq)
+      sleep(&log.commitreq, &log.lock);
+    log.sealing = 1;
+    while(log.outstanding > 0)
+      sleep(&log, &log.lock);
+    log.commitreq = 0;
+    log.clh = log.lh;
+    id = log.seq;
+    release(&log.lock);
+
+    snapshot();
+
+    acquire(&log.lock);
+    log.lh.n = 0;
+    log.seq++;
+    log.sealing = 0;
+    wakeup(&log);
+    release(&log.lock);
+
+    commit(id);
+  }
+}
+
 // Caller has modified b->data and is done with the buffer.
-// Record the block number and pin in the cache with B_DIRTY.
-// commit()/write_log() will do the disk write.
+// Record the block number and pin the buffer in the cache.
+// The committer will do the disk write.
 //
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bread(...)
@@ -215,7 +428,7 @@ log_write(struct buf *b)
 {
   int i;
 
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+  if (log.lh.n >= log.size)
     panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
@@ -226,9 +439,12 @@ log_write(struct buf *b)
       break;
   }
   log.lh.block[i] = b->blockno;
-  if (i == log.lh.n)
+  if (i == log.lh.n) {
+    bpin(b); // prevent eviction until installed
+    if (log.lh.n == 0)
+      log.opened = ticks;
     log.lh.n++;
-  b->flags |= B_DIRTY; // prevent eviction
+    myproc()->ru.oublock++;  // the committer writes it for us
+  }
   release(&log.lock);
 }
-
@@ -30,6 +30,10 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  pollinit();      // poll() waiters
+  vdsoinit();      // pages shared with user space
+  profinit();      // sampling profiler
+  traceinit();     // event tracing
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
@@ -54,7 +54,21 @@ iderw(struct buf *b)
   if(b->flags & B_DIRTY){
     b->flags &= ~B_DIRTY;
     memmove(p, b->data, BSIZE);
-  } else
+  } else {
+    // Writes are charged by log_write().
+    if(myproc())
+      myproc()->ru.inblock++;
     memmove(b->data, p, BSIZE);
+  }
   b->flags |= B_VALID;
 }
+
+// Sync a batch of bufs with disk.
+void
+iderwv(struct buf **bs, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++)
+    iderw(bs[i]);
+}
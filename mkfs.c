@@ -15,14 +15,12 @@
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 #endif
 
-#define NINODES 200
-
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
 
-int nbitmap = FSSIZE/(BSIZE*8) + 1;
-int ninodeblocks = NINODES / IPB + 1;
-int nlog = LOGSIZE;
+int nbitmap = BMAPBLOCKS;
+int ninodeblocks = IBLOCKS;
+int nlog;     // header blocks + LOGSIZE data blocks
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
@@ -40,6 +38,12 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+uint islot(uint ind, uint i);
+void rootlink(uint inum, char *name);
+void rootwrite(uint rootino);
+
+struct dirent rootde[NINODES];  // entries of the root directory
+int nrootde;
 
 // convert to intel byte order
 ushort
@@ -68,21 +72,27 @@ int
 main(int argc, char *argv[])
 {
   int i, cc, fd;
-  uint rootino, inum, off;
-  struct dirent de;
+  uint rootino, inum, flags;
   char buf[BSIZE];
-  struct dinode din;
 
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  flags = 0;
+  if(argc > 1 && strcmp(argv[1], "-d") == 0){
+    flags |= SB_DELAYED;
+    argc--;
+    argv++;
+  }
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-d] fs.img files...\n");
     exit(1);
   }
 
   assert((BSIZE % sizeof(struct dinode)) == 0);
   assert((BSIZE % sizeof(struct dirent)) == 0);
+  assert(sizeof(struct dirhead) == sizeof(struct dirent));
+  assert(sizeof(struct dirmap) == sizeof(struct dirent));
 
   fsfd = open(argv[1], O_RDWR|O_CREAT|O_TRUNC, 0666);
   if(fsfd < 0){
@@ -91,6 +101,8 @@ main(int argc, char *argv[])
   }
 
   // 1 fs block = 1 disk sector
+  for(nlog = LOGSIZE + 1; nlog - LOGHEAD(nlog) < LOGSIZE; nlog++)
+    ;
   nmeta = 2 + nlog + ninodeblocks + nbitmap;
   nblocks = FSSIZE - nmeta;
 
@@ -101,6 +113,8 @@ main(int argc, char *argv[])
   sb.logstart = xint(2);
   sb.inodestart = xint(2+nlog);
   sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.bsize = xint(BSIZE);
+  sb.flags = xint(flags);
 
   printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
          nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
@@ -117,15 +131,8 @@ main(int argc, char *argv[])
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
-
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  rootlink(rootino, ".");
+  rootlink(rootino, "..");
 
   for(i = 2; i < argc; i++){
     assert(index(argv[i], '/') == 0);
@@ -143,11 +150,7 @@ main(int argc, char *argv[])
       ++argv[i];
 
     inum = ialloc(T_FILE);
-
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, argv[i], DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    rootlink(inum, argv[i]);
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -155,12 +158,7 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
+  rootwrite(rootino);
 
   balloc(freeblock);
 
@@ -259,8 +257,7 @@ iappend(uint inum, void *xp, int n)
   uint fbn, off, n1;
   struct dinode din;
   char buf[BSIZE];
-  uint indirect[NINDIRECT];
-  uint x;
+  uint x, b;
 
   rinode(inum, &din);
   off = xint(din.size);
@@ -273,16 +270,17 @@ iappend(uint inum, void *xp, int n)
         din.addrs[fbn] = xint(freeblock++);
       }
       x = xint(din.addrs[fbn]);
-    } else {
+    } else if(fbn < NDIRECT + NINDIRECT){
       if(xint(din.addrs[NDIRECT]) == 0){
         din.addrs[NDIRECT] = xint(freeblock++);
       }
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
+      x = islot(xint(din.addrs[NDIRECT]), fbn - NDIRECT);
+    } else {
+      if(xint(din.addrs[NDIRECT+1]) == 0){
+        din.addrs[NDIRECT+1] = xint(freeblock++);
       }
-      x = xint(indirect[fbn-NDIRECT]);
+      b = fbn - NDIRECT - NINDIRECT;
+      x = islot(islot(xint(din.addrs[NDIRECT+1]), b / NINDIRECT), b % NINDIRECT);
     }
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
@@ -295,3 +293,101 @@ iappend(uint inum, void *xp, int n)
   din.size = xint(off);
   winode(inum, &din);
 }
+
+// Return the block in slot i of indirect block ind,
+// allocating it if the slot is empty.
+uint
+islot(uint ind, uint i)
+{
+  uint indirect[NINDIRECT];
+
+  rsect(ind, (char*)indirect);
+  if(indirect[i] == 0){
+    indirect[i] = xint(freeblock++);
+    wsect(ind, (char*)indirect);
+  }
+  return xint(indirect[i]);
+}
+
+void
+rootlink(uint inum, char *name)
+{
+  assert(nrootde < NINODES);
+  bzero(&rootde[nrootde], sizeof(struct dirent));
+  rootde[nrootde].inum = xshort(inum);
+  strncpy(rootde[nrootde].name, name, DIRSIZ);
+  nrootde++;
+}
+
+// Same as dirhash() in fs.c.
+uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = (h ^ (uchar)name[i]) * 16777619;
+  return h;
+}
+
+// Write the root directory: linear if its entries fit in a
+// block, else hashed with the fewest leaves that hold them.
+void
+rootwrite(uint rootino)
+{
+  char buf[BSIZE];
+  struct dinode din;
+  struct dirhead *head;
+  struct dirent *de;
+  struct dirmap *map;
+  int count[DIRMAPSZ];
+  uint depth, mask, i, l, n, off;
+
+  if(nrootde <= DPB){
+    iappend(rootino, rootde, nrootde * sizeof(struct dirent));
+    // fix size of root inode dir
+    rinode(rootino, &din);
+    off = xint(din.size);
+    off = ((off/BSIZE) + 1) * BSIZE;
+    din.size = xint(off);
+    winode(rootino, &din);
+    return;
+  }
+
+  for(depth = 1; ; depth++){
+    assert((1 << depth) <= DIRMAPSZ);
+    mask = (1 << depth) - 1;
+    memset(count, 0, sizeof(count));
+    for(i = 2; i < nrootde; i++)
+      if(++count[dirhash(rootde[i].name) & mask] > DPB - 1)
+        break;
+    if(i == nrootde)
+      break;
+  }
+
+  bzero(buf, sizeof(buf));
+  head = (struct dirhead*)buf;
+  head->magic = xshort(DIRMAGIC);
+  head->depth = xshort(depth);
+  de = (struct dirent*)buf;
+  de[1] = rootde[0];
+  de[2] = rootde[1];
+  map = (struct dirmap*)buf + 3;
+  for(l = 0; l <= mask; l++)
+    map[l/7].leaf[l%7] = xshort(l + 1);
+  iappend(rootino, buf, BSIZE);
+
+  for(l = 0; l <= mask; l++){
+    bzero(buf, sizeof(buf));
+    head->magic = xshort(DIRMAGIC);
+    head->depth = xshort(depth);
+    n = 1;
+    for(i = 2; i < nrootde; i++)
+      if((dirhash(rootde[i].name) & mask) == l)
+        de[n++] = rootde[i];
+    iappend(rootino, buf, BSIZE);
+  }
+}
+
@@ -11,6 +11,14 @@
 
 #define CR4_PSE         0x00000010      // Page size extension
 
+// Model specific registers for SYSENTER
+#define MSR_SYSENTER_CS   0x174
+#define MSR_SYSENTER_ESP  0x175
+#define MSR_SYSENTER_EIP  0x176
+
+// CPUID function 1 %edx feature flags
+#define CPUID_SEP       0x00000800      // SYSENTER and SYSEXIT
+
 // various segment selectors.
 #define SEG_KCODE 1  // kernel code
 #define SEG_KDATA 2  // kernel data+stack
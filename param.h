@@ -1,14 +1,23 @@
 #define NPROC        64  // maximum number of processes
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
-#define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NOFILE       64  // open files per process
+#define NFILE       200  // open files per system
+#define NINODE      200  // i-nodes cached before unused ones are recycled
+#define NMAPRUN       8  // cached block mapping runs per i-node
+#define NDCACHE     128  // cached directory name lookups
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
-#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define MAXOPBLOCKS  16  // max # of blocks any FS op writes
+#ifndef LOGSIZE
+#define LOGSIZE      120  // max data blocks in on-disk log
+#endif
+#define MAXWRITEBLOCKS (LOGSIZE/4 > MAXOPBLOCKS*2 ? LOGSIZE/4 : MAXOPBLOCKS*2)  // max # of blocks one write() chunk logs
+#define NBUF         (LOGSIZE*2+MAXOPBLOCKS*3)  // size of disk block cache
+#ifndef FSSIZE
+#define FSSIZE       (20000*512/BSIZE)  // size of file system in blocks
+#endif
+#define NINODES      200  // number of i-nodes in file system
+#define COMMITTICKS  100  // max age of a transaction with SB_DELAYED
 
@@ -7,18 +7,48 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "poll.h"
 
-#define PIPESIZE 512
+#define PIPEPAGES 16  // max pages in a pipe's ring
 
+// The ring is a power-of-two number of pages, so nread and
+// nwrite can wrap around and still index it.
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *buf[PIPEPAGES];  // pages of the ring
+  uint size;      // ring size in bytes
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int rwait;      // readers sleeping on nread
+  int wwait;      // writers sleeping on nwrite
+  struct epitem *watch;  // epoll items watching either end
 };
 
+// Copy n bytes between addr and the ring buf of size bytes,
+// starting at ring offset off: into the ring if in is set,
+// else out of it. Copies a page at a time.
+static void
+ringcopy(char **buf, uint size, uint off, char *addr, int n, int in)
+{
+  uint i;
+  int m;
+  char *q;
+
+  for(; n > 0; n -= m, off += m, addr += m){
+    i = off & (size - 1);
+    q = buf[i / PGSIZE] + i % PGSIZE;
+    m = PGSIZE - i % PGSIZE;
+    if(m > n)
+      m = n;
+    if(in)
+      memmove(q, addr, m);
+    else
+      memmove(addr, q, m);
+  }
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -30,6 +60,10 @@ pipealloc(struct file **f0, struct file **f1)
     goto bad;
   if((p = (struct pipe*)kalloc()) == 0)
     goto bad;
+  memset(p, 0, sizeof(*p));
+  if((p->buf[0] = kalloc()) == 0)
+    goto bad;
+  p->size = PGSIZE;
   p->readopen = 1;
   p->writeopen = 1;
   p->nwrite = 0;
@@ -38,10 +72,12 @@ pipealloc(struct file **f0, struct file **f1)
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
   (*f0)->writable = 0;
+  (*f0)->nonblock = 0;
   (*f0)->pipe = p;
   (*f1)->type = FD_PIPE;
   (*f1)->readable = 0;
   (*f1)->writable = 1;
+  (*f1)->nonblock = 0;
   (*f1)->pipe = p;
   return 0;
 
@@ -59,6 +95,8 @@ pipealloc(struct file **f0, struct file **f1)
 void
 pipeclose(struct pipe *p, int writable)
 {
+  int i;
+
   acquire(&p->lock);
   if(writable){
     p->writeopen = 0;
@@ -67,55 +105,222 @@ pipeclose(struct pipe *p, int writable)
     p->readopen = 0;
     wakeup(&p->nwrite);
   }
+  pollwakeup(p->watch, writable ? POLLHUP : POLLERR);
   if(p->readopen == 0 && p->writeopen == 0){
     release(&p->lock);
+    for(i = 0; i < p->size / PGSIZE; i++)
+      kfree(p->buf[i]);
     kfree((char*)p);
   } else
     release(&p->lock);
 }
 
 //PAGEBREAK: 40
+// If nonblock is set, write only what fits without waiting,
+// and return -1 if nothing does.
 int
-pipewrite(struct pipe *p, char *addr, int n)
+pipewrite(struct pipe *p, char *addr, int n, int nonblock)
 {
-  int i;
+  int i, m;
 
   acquire(&p->lock);
-  for(i = 0; i < n; i++){
-    while(p->nwrite == p->nread + PIPESIZE){  //DOC: pipewrite-full
-      if(p->readopen == 0 || myproc()->killed){
+  for(i = 0; i < n; i += m){
+    while(p->nwrite == p->nread + p->size){  //DOC: pipewrite-full
+      if(p->readopen == 0 || myproc()->killed || (nonblock && i == 0)){
         release(&p->lock);
         return -1;
       }
-      wakeup(&p->nread);
+      if(nonblock)
+        goto out;
+      if(p->rwait)
+        wakeup(&p->nread);
+      pollwakeup(p->watch, POLLIN);
+      p->wwait++;
       sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
+      p->wwait--;
     }
-    p->data[p->nwrite++ % PIPESIZE] = addr[i];
+    m = p->size - (p->nwrite - p->nread);
+    if(m > n - i)
+      m = n - i;
+    ringcopy(p->buf, p->size, p->nwrite, addr + i, m, 1);
+    p->nwrite += m;
   }
-  wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+out:
+  if(p->rwait)
+    wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+  pollwakeup(p->watch, POLLIN);
   release(&p->lock);
-  return n;
+  return i;
 }
 
+// If nonblock is set, return -1 rather than wait
+// for an empty pipe.
 int
-piperead(struct pipe *p, char *addr, int n)
+piperead(struct pipe *p, char *addr, int n, int nonblock)
 {
-  int i;
+  int m;
 
   acquire(&p->lock);
   while(p->nread == p->nwrite && p->writeopen){  //DOC: pipe-empty
-    if(myproc()->killed){
+    if(myproc()->killed || nonblock){
       release(&p->lock);
       return -1;
     }
+    p->rwait++;
     sleep(&p->nread, &p->lock); //DOC: piperead-sleep
+    p->rwait--;
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(p->nread == p->nwrite)
+  m = p->nwrite - p->nread;  //DOC: piperead-copy
+  if(m > n)
+    m = n;
+  ringcopy(p->buf, p->size, p->nread, addr, m, 0);
+  p->nread += m;
+  if(p->wwait)
+    wakeup(&p->nwrite);  //DOC: piperead-wakeup
+  pollwakeup(p->watch, POLLOUT);
+  release(&p->lock);
+  return m;
+}
+
+// Copy up to n bytes from addr into p without waiting.
+// Returns the number copied, or -1 if p has no reader.
+int
+pipeput(struct pipe *p, char *addr, int n)
+{
+  int m;
+
+  acquire(&p->lock);
+  if(p->readopen == 0){
+    release(&p->lock);
+    return -1;
+  }
+  m = p->size - (p->nwrite - p->nread);
+  if(m > n)
+    m = n;
+  ringcopy(p->buf, p->size, p->nwrite, addr, m, 1);
+  p->nwrite += m;
+  if(p->rwait)
+    wakeup(&p->nread);
+  pollwakeup(p->watch, POLLIN);
+  release(&p->lock);
+  return m;
+}
+
+// Wait until p has room for more data.
+// Returns -1 if p has no reader or the caller was killed,
+// or if p is full and nonblock is set.
+int
+pipewaitw(struct pipe *p, int nonblock)
+{
+  int r;
+
+  acquire(&p->lock);
+  while(p->nwrite == p->nread + p->size){
+    if(p->readopen == 0 || myproc()->killed)
       break;
-    addr[i] = p->data[p->nread++ % PIPESIZE];
+    if(nonblock){
+      release(&p->lock);
+      return -1;
+    }
+    if(p->rwait)
+      wakeup(&p->nread);
+    pollwakeup(p->watch, POLLIN);
+    p->wwait++;
+    sleep(&p->nwrite, &p->lock);
+    p->wwait--;
   }
-  wakeup(&p->nwrite);  //DOC: piperead-wakeup
+  r = (p->readopen && !myproc()->killed) ? 0 : -1;
+  release(&p->lock);
+  return r;
+}
+
+// Resize p's ring to hold at least n bytes, rounded up to
+// a power-of-two number of pages. n of 0 leaves it alone.
+// Returns the ring size, or -1 if n is too big or smaller
+// than the data already in the pipe.
+int
+pipesize(struct pipe *p, int n)
+{
+  char *buf[PIPEPAGES], *old[PIPEPAGES];
+  int i, np, nold, m;
+  uint cnt, off, j;
+
+  if(n == 0)
+    return p->size;
+  for(np = 1; np * PGSIZE < n; np *= 2)
+    if(np == PIPEPAGES)
+      return -1;
+  for(i = 0; i < np; i++){
+    if((buf[i] = kalloc()) == 0){
+      while(--i >= 0)
+        kfree(buf[i]);
+      return -1;
+    }
+  }
+
+  acquire(&p->lock);
+  cnt = p->nwrite - p->nread;
+  if(cnt > np * PGSIZE){
+    release(&p->lock);
+    for(i = 0; i < np; i++)
+      kfree(buf[i]);
+    return -1;
+  }
+  for(off = 0; off < cnt; off += m){
+    j = (p->nread + off) & (p->size - 1);
+    m = PGSIZE - j % PGSIZE;
+    if(m > cnt - off)
+      m = cnt - off;
+    ringcopy(buf, np * PGSIZE, off, p->buf[j / PGSIZE] + j % PGSIZE, m, 1);
+  }
+  nold = p->size / PGSIZE;
+  for(i = 0; i < PIPEPAGES; i++){
+    old[i] = p->buf[i];
+    p->buf[i] = i < np ? buf[i] : 0;
+  }
+  p->size = np * PGSIZE;
+  p->nread = 0;
+  p->nwrite = cnt;
+  if(p->wwait)
+    wakeup(&p->nwrite);
+  pollwakeup(p->watch, POLLOUT);
+  release(&p->lock);
+
+  for(i = 0; i < nold; i++)
+    kfree(old[i]);
+  return np * PGSIZE;
+}
+
+// Return the poll events p is ready for, as seen from
+// its write end if writable is set, else its read end.
+int
+pipepoll(struct pipe *p, int writable)
+{
+  int r;
+
+  r = 0;
+  acquire(&p->lock);
+  if(writable){
+    if(p->readopen == 0)
+      r |= POLLERR;
+    else if(p->nwrite != p->nread + p->size)
+      r |= POLLOUT;
+  } else {
+    if(p->nread != p->nwrite)
+      r |= POLLIN;
+    if(p->writeopen == 0)
+      r |= POLLHUP;
+  }
+  release(&p->lock);
+  return r;
+}
+
+// Add item it to the epoll items watching p,
+// or remove it if on is not set.
+void
+pipewatch(struct pipe *p, struct epitem *it, int on)
+{
+  acquire(&p->lock);
+  pollwatch(&p->watch, it, on);
   release(&p->lock);
-  return i;
 }
@@ -0,0 +1,67 @@
+// Pipe throughput: a child writes MB megabytes into a pipe
+// while the parent reads them.
+// Usage: pipebench [pipe size in bytes [MB]]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define CHUNK 8192
+
+char buf[CHUNK];
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2], pid, mb, n, t;
+  uint tot, want;
+
+  mb = 4;
+  if(argc > 2)
+    mb = atoi(argv[2]);
+  want = mb * 1024 * 1024;
+
+  if(pipe(fds) < 0){
+    printf(2, "pipebench: pipe failed\n");
+    exit();
+  }
+  if(argc > 1 && fcntl(fds[1], F_SETPIPE_SZ, atoi(argv[1])) < 0){
+    printf(2, "pipebench: cannot set pipe size %s\n", argv[1]);
+    exit();
+  }
+  printf(1, "pipebench: %d MB through a %d byte pipe\n",
+         mb, fcntl(fds[0], F_GETPIPE_SZ, 0));
+
+  t = uptime();
+  pid = fork();
+  if(pid < 0){
+    printf(2, "pipebench: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(fds[0]);
+    for(tot = 0; tot < want; tot += n){
+      n = want - tot < CHUNK ? want - tot : CHUNK;
+      if(write(fds[1], buf, n) != n){
+        printf(2, "pipebench: write failed\n");
+        break;
+      }
+    }
+    exit();
+  }
+
+  close(fds[1]);
+  tot = 0;
+  while((n = read(fds[0], buf, sizeof(buf))) > 0)
+    tot += n;
+  wait();
+  t = uptime() - t;
+  if(tot != want)
+    printf(2, "pipebench: read %d of %d bytes\n", tot, want);
+  printf(1, "pipebench: %d ticks", t);
+  if(t > 0)
+    printf(1, ", %d KB/tick", tot / 1024 / t);
+  printf(1, "\n");
+  exit();
+}
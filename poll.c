@@ -0,0 +1,493 @@
+//
+// Waiting for any of several files to become ready.
+//
+// Pipes and the console call pollwakeup() whenever they
+// change state. That bumps a sequence number and wakes every
+// process in poll(), which then rescans its files.
+//
+// An epoll instead keeps an interest set of items, and each
+// pipe or device keeps a list of the items watching it.
+// pollwakeup() queues those items on their epoll's ready
+// list, so epoll_wait() only looks at files that changed.
+//
+// Both cost nothing while no one is waiting.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "fs.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "poll.h"
+
+// A file in an epoll's interest set.
+struct epitem {
+  struct epoll *ep;
+  struct file *f;         // watched file; 0 if free
+  int fd;                 // its fd when added
+  int events;             // EPOLLIN etc., maybe EPOLLET
+  int data;
+  int queued;             // on ep's ready list
+  struct epitem *wnext;   // next item watching the same pipe or device
+  struct epitem *fnext;   // next item watching the same file
+  struct epitem *rnext;   // next on the ready list
+};
+
+// Fits in the page epollcreate() allocates.
+struct epoll {
+  struct spinlock lock;   // protects the ready list and below
+  struct sleeplock ctl;   // held by epoll_ctl() and while
+                          // epoll_wait() scans, so items stay put
+  struct epitem *ready;   // ready list, in order of arrival
+  struct epitem *rtail;
+  int nwait;              // processes in epoll_wait()
+  int ntimed;             // how many of them have a timeout
+  struct epoll *tnext;    // on polls.timed if ntimed > 0
+  int ref;                // the epoll file, and epollforget()s
+  struct epitem item[EPOLLMAX];
+};
+
+struct {
+  struct spinlock lock;
+  uint seq;    // bumped by every pollwakeup()
+  int nwait;   // processes in poll()
+  int ntimed;  // processes in poll() or epoll_wait() with a timeout
+  struct epoll *timed;  // epolls with a timed waiter
+  // Also protects epoll refs, it->f and the files' epitems lists.
+} polls;
+
+void
+pollinit(void)
+{
+  initlock(&polls.lock, "poll");
+}
+
+// Put it on its epoll's ready list, if not there already.
+static void
+epollqueue(struct epitem *it)
+{
+  struct epoll *ep = it->ep;
+
+  acquire(&ep->lock);
+  if(!it->queued){
+    it->queued = 1;
+    it->rnext = 0;
+    if(ep->rtail)
+      ep->rtail->rnext = it;
+    else
+      ep->ready = it;
+    ep->rtail = it;
+    if(ep->nwait)
+      wakeup(ep);
+  }
+  release(&ep->lock);
+}
+
+// Tell waiters that a file may have become ready for
+// events. watch is the file's list of epoll items; the
+// caller holds the lock that protects it and has made
+// the change visible to filepoll().
+void
+pollwakeup(struct epitem *watch, int events)
+{
+  for(; watch; watch = watch->wnext)
+    if(events & (watch->events | POLLERR | POLLHUP))
+      epollqueue(watch);
+
+  if(polls.nwait == 0)
+    return;
+  acquire(&polls.lock);
+  polls.seq++;
+  wakeup(&polls.seq);
+  release(&polls.lock);
+}
+
+// Add it to the watch list *head, or remove it if on
+// is not set. The caller holds the list's lock.
+void
+pollwatch(struct epitem **head, struct epitem *it, int on)
+{
+  struct epitem **pp;
+
+  if(on){
+    it->wnext = *head;
+    *head = it;
+    return;
+  }
+  for(pp = head; *pp; pp = &(*pp)->wnext){
+    if(*pp == it){
+      *pp = it->wnext;
+      return;
+    }
+  }
+  panic("pollwatch");
+}
+
+// Called on every clock tick so that waiters
+// with a timeout can notice it has expired.
+void
+polltick(void)
+{
+  struct epoll *ep;
+
+  if(polls.ntimed == 0)
+    return;
+  acquire(&polls.lock);
+  wakeup(&polls.seq);
+  for(ep = polls.timed; ep; ep = ep->tnext)
+    wakeup(ep);
+  release(&polls.lock);
+}
+
+// Fill in revents for the n entries of fds.
+// Returns how many have some event.
+static int
+pollscan(struct pollfd *fds, int n)
+{
+  struct file *f;
+  int i, r;
+
+  r = 0;
+  for(i = 0; i < n; i++){
+    fds[i].revents = 0;
+    if(fds[i].fd < 0)
+      continue;
+    if(fds[i].fd >= NOFILE || (f = myproc()->ofile[fds[i].fd]) == 0)
+      fds[i].revents = POLLNVAL;
+    else
+      fds[i].revents = filepoll(f, fds[i].events);
+    if(fds[i].revents)
+      r++;
+  }
+  return r;
+}
+
+// Wait until one of the n files in fds is ready, or
+// for timeout ticks if timeout is not negative.
+// Returns the number of ready entries, 0 on timeout,
+// or -1 if the caller was killed.
+int
+poll(struct pollfd *fds, int n, int timeout)
+{
+  uint seq, end;
+  int r;
+
+  acquire(&polls.lock);
+  polls.nwait++;
+  if(timeout > 0)
+    polls.ntimed++;
+  end = ticks + timeout;
+  release(&polls.lock);
+
+  for(;;){
+    acquire(&polls.lock);
+    seq = polls.seq;
+    release(&polls.lock);
+    if((r = pollscan(fds, n)) > 0 || timeout == 0)
+      break;
+    if(timeout > 0 && (int)(end - ticks) <= 0)
+      break;
+    if(myproc()->killed){
+      r = -1;
+      break;
+    }
+    acquire(&polls.lock);
+    while(polls.seq == seq && !myproc()->killed &&
+          (timeout < 0 || (int)(end - ticks) > 0))
+      sleep(&polls.seq, &polls.lock);
+    release(&polls.lock);
+  }
+
+  acquire(&polls.lock);
+  polls.nwait--;
+  if(timeout > 0)
+    polls.ntimed--;
+  release(&polls.lock);
+  return r;
+}
+
+//PAGEBREAK!
+struct epoll*
+epollcreate(void)
+{
+  struct epoll *ep;
+
+  if(sizeof(struct epoll) > PGSIZE)
+    panic("epollcreate");
+  if((ep = (struct epoll*)kalloc()) == 0)
+    return 0;
+  memset(ep, 0, sizeof(*ep));
+  initlock(&ep->lock, "epoll");
+  initsleeplock(&ep->ctl, "epollctl");
+  ep->ref = 1;
+  return ep;
+}
+
+// Drop a reference to ep, freeing it with the last one.
+static void
+epollput(struct epoll *ep)
+{
+  int ref;
+
+  acquire(&polls.lock);
+  ref = --ep->ref;
+  release(&polls.lock);
+  if(ref == 0)
+    kfree((char*)ep);
+}
+
+// Take it out of its epoll's ready list.
+static void
+epollunqueue(struct epitem *it)
+{
+  struct epoll *ep = it->ep;
+  struct epitem **pp, *prev;
+
+  acquire(&ep->lock);
+  if(it->queued){
+    prev = 0;
+    for(pp = &ep->ready; *pp != it; pp = &(*pp)->rnext)
+      prev = *pp;
+    *pp = it->rnext;
+    if(ep->rtail == it)
+      ep->rtail = prev;
+    it->queued = 0;
+  }
+  release(&ep->lock);
+}
+
+// Stop watching it's file. The caller holds ep->ctl.
+static void
+epolldel(struct epitem *it)
+{
+  struct epitem **pp;
+
+  filewatch(it->f, it, 0);
+  epollunqueue(it);
+  acquire(&polls.lock);
+  for(pp = &it->f->epitems; *pp != it; pp = &(*pp)->fnext)
+    ;
+  *pp = it->fnext;
+  it->f = 0;
+  release(&polls.lock);
+}
+
+// Take file f out of every epoll watching it. Called by
+// fileclose() before it lets go of f's last reference, so
+// that items go away with the file, as if deleted.
+void
+epollforget(struct file *f)
+{
+  struct epitem *it;
+  struct epoll *ep;
+
+  for(;;){
+    acquire(&polls.lock);
+    if((it = f->epitems) == 0){
+      release(&polls.lock);
+      return;
+    }
+    ep = it->ep;
+    ep->ref++;  // in case the epoll is closed meanwhile
+    release(&polls.lock);
+    acquiresleep(&ep->ctl);
+    if(it->f == f)
+      epolldel(it);
+    releasesleep(&ep->ctl);
+    epollput(ep);
+  }
+}
+
+// Add, change or remove the interest in file fd
+// described by ev, as op says. Items are matched on
+// both fd and file, since the fd may have been closed
+// and reused while a dup of its file kept the item.
+// If fd is closed, EPOLL_CTL_DEL removes any item
+// added under it.
+int
+epollctl(struct epoll *ep, int op, int fd, struct epoll_event *ev)
+{
+  struct file *f;
+  struct epitem *it, *free;
+  int r;
+
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  if((f = myproc()->ofile[fd]) == 0 && op != EPOLL_CTL_DEL)
+    return -1;
+  if(f && f->type == FD_EPOLL)
+    return -1;
+
+  acquiresleep(&ep->ctl);
+  free = 0;
+  for(it = ep->item; it < ep->item + EPOLLMAX; it++){
+    if(it->f == 0){
+      if(free == 0)
+        free = it;
+    } else if(it->fd == fd && (it->f == f || f == 0))
+      break;
+  }
+  if(it == ep->item + EPOLLMAX)
+    it = 0;
+
+  r = 0;
+  switch(op){
+  case EPOLL_CTL_ADD:
+    if(it || free == 0){
+      r = -1;
+      break;
+    }
+    it = free;
+    it->ep = ep;
+    it->fd = fd;
+    it->events = ev->events;
+    it->data = ev->data;
+    it->queued = 0;
+    acquire(&polls.lock);
+    it->f = f;
+    it->fnext = f->epitems;
+    f->epitems = it;
+    release(&polls.lock);
+    filewatch(f, it, 1);
+    epollqueue(it);  // epoll_wait() checks if it is ready
+    break;
+  case EPOLL_CTL_MOD:
+    if(it == 0){
+      r = -1;
+      break;
+    }
+    acquire(&ep->lock);
+    it->events = ev->events;
+    it->data = ev->data;
+    release(&ep->lock);
+    epollqueue(it);
+    break;
+  case EPOLL_CTL_DEL:
+    if(it == 0){
+      r = -1;
+      break;
+    }
+    epolldel(it);
+    break;
+  default:
+    r = -1;
+  }
+  releasesleep(&ep->ctl);
+  return r;
+}
+
+// Report up to n ready items from ep's ready list in evs.
+// A level-triggered item that is still ready goes back on
+// the list, so the next epoll_wait() checks it again; an
+// edge-triggered one waits for the next change.
+static int
+epollscan(struct epoll *ep, struct epoll_event *evs, int n)
+{
+  struct epitem *it, *last;
+  int cnt, ev;
+
+  acquire(&ep->lock);
+  last = ep->rtail;
+  release(&ep->lock);
+
+  cnt = 0;
+  while(cnt < n && last){
+    acquire(&ep->lock);
+    it = ep->ready;
+    ep->ready = it->rnext;
+    if(ep->ready == 0)
+      ep->rtail = 0;
+    it->queued = 0;
+    release(&ep->lock);
+
+    if((ev = filepoll(it->f, it->events)) != 0){
+      evs[cnt].events = ev;
+      evs[cnt].data = it->data;
+      cnt++;
+      if(!(it->events & EPOLLET))
+        epollqueue(it);
+    }
+    if(it == last)
+      break;
+  }
+  return cnt;
+}
+
+// Wait until some of the files watched by ep are ready,
+// or for timeout ticks if timeout is not negative. Fills
+// in up to n events and returns how many, 0 on timeout,
+// or -1 if the caller was killed.
+int
+epollwait(struct epoll *ep, struct epoll_event *evs, int n, int timeout)
+{
+  uint end;
+  int r;
+
+  acquire(&ep->lock);
+  ep->nwait++;
+  release(&ep->lock);
+  if(timeout > 0){
+    acquire(&polls.lock);
+    polls.ntimed++;
+    if(ep->ntimed++ == 0){
+      ep->tnext = polls.timed;
+      polls.timed = ep;
+    }
+    release(&polls.lock);
+  }
+  end = ticks + timeout;
+
+  for(;;){
+    acquiresleep(&ep->ctl);
+    r = epollscan(ep, evs, n);
+    releasesleep(&ep->ctl);
+    if(r > 0 || timeout == 0)
+      break;
+    if(timeout > 0 && (int)(end - ticks) <= 0)
+      break;
+    if(myproc()->killed){
+      r = -1;
+      break;
+    }
+    acquire(&ep->lock);
+    while(ep->ready == 0 && !myproc()->killed &&
+          (timeout < 0 || (int)(end - ticks) > 0))
+      sleep(ep, &ep->lock);
+    release(&ep->lock);
+  }
+
+  if(timeout > 0){
+    struct epoll **pp;
+
+    acquire(&polls.lock);
+    polls.ntimed--;
+    if(--ep->ntimed == 0){
+      for(pp = &polls.timed; *pp != ep; pp = &(*pp)->tnext)
+        ;
+      *pp = ep->tnext;
+    }
+    release(&polls.lock);
+  }
+  acquire(&ep->lock);
+  ep->nwait--;
+  release(&ep->lock);
+  return r;
+}
+
+// Close ep, no longer watching any files.
+void
+epollclose(struct epoll *ep)
+{
+  struct epitem *it;
+
+  acquiresleep(&ep->ctl);
+  for(it = ep->item; it < ep->item + EPOLLMAX; it++)
+    if(it->f)
+      epolldel(it);
+  releasesleep(&ep->ctl);
+  epollput(ep);
+}
@@ -0,0 +1,33 @@
+// Descriptors and events for poll().
+struct pollfd {
+  int fd;           // file descriptor, ignored if negative
+  short events;     // events to wait for
+  short revents;    // events that happened
+};
+
+#define POLLIN    0x001  // can read without blocking
+#define POLLOUT   0x004  // can write without blocking
+#define POLLERR   0x008  // write end of a pipe with no reader
+#define POLLHUP   0x010  // read end of a pipe with no writer
+#define POLLNVAL  0x020  // fd is not open
+
+#define POLLMAX   64     // max pollfds per poll()
+
+// Events and control operations for epoll_wait()
+// and epoll_ctl().
+struct epoll_event {
+  int events;       // events to watch for, or that happened
+  int data;         // returned unchanged with the events
+};
+
+#define EPOLLIN   POLLIN
+#define EPOLLOUT  POLLOUT
+#define EPOLLERR  POLLERR
+#define EPOLLHUP  POLLHUP
+#define EPOLLET   0x100  // edge-triggered: report each change once
+
+#define EPOLL_CTL_ADD  1
+#define EPOLL_CTL_DEL  2
+#define EPOLL_CTL_MOD  3
+
+#define EPOLLMAX  64     // max fds watched by one epoll
@@ -6,6 +6,10 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "vdso.h"
+#include "trace.h"
+#include "procinfo.h"
+#include "rusage.h"
 
 struct {
   struct spinlock lock;
@@ -14,6 +18,20 @@ struct {
 
 static struct proc *initproc;
 
+// Processes are also hashed by pid, so kill() and set_priority()
+// can find one without ptable.lock. Such lookups run between
+// rcubegin() and rcuend(), with interrupts off, and record the
+// epoch they began in. freeproc() unhashes a slot and stamps it
+// with the current epoch, then starts a new one; allocproc()
+// only reuses the slot once no lookup from that epoch or
+// earlier is still running. So a lookup that found a slot can
+// keep using it, though the process may have exited meanwhile.
+// The hash is changed only with ptable.lock held.
+#define NPIDHASH 64
+#define PIDHASH(pid) ((pid) & (NPIDHASH-1))
+static struct proc *pidhash[NPIDHASH];
+static uint epoch = 1;
+
 int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
@@ -74,6 +92,86 @@ myproc(void) {
   return p;
 }
 
+static void
+rcubegin(void)
+{
+  pushcli();
+  mycpu()->rcuepoch = epoch;
+  __sync_synchronize();
+}
+
+static void
+rcuend(void)
+{
+  __sync_synchronize();
+  mycpu()->rcuepoch = 0;
+  popcli();
+}
+
+// Has every lookup that began in epoch e or earlier finished?
+static int
+rcudone(uint e)
+{
+  struct cpu *c;
+  uint r;
+
+  for(c = cpus; c < &cpus[ncpu]; c++){
+    r = c->rcuepoch;
+    if(r != 0 && r <= e)
+      return 0;
+  }
+  return 1;
+}
+
+// Return the live process with the given pid, or 0.
+// Must be called between rcubegin() and rcuend().
+static struct proc*
+pidlookup(int pid)
+{
+  struct proc *p;
+
+  for(p = pidhash[PIDHASH(pid)]; p; p = p->hnext)
+    if(p->pid == pid && p->state != UNUSED)
+      return p;
+  return 0;
+}
+
+// Add p to the pid hash. Caller must hold ptable.lock.
+static void
+hashproc(struct proc *p)
+{
+  p->hnext = pidhash[PIDHASH(p->pid)];
+  __sync_synchronize();  // lookups must see p filled in
+  pidhash[PIDHASH(p->pid)] = p;
+}
+
+// Free the zombie p and its slot.
+// Caller must hold ptable.lock.
+static void
+freeproc(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &pidhash[PIDHASH(p->pid)]; *pp; pp = &(*pp)->hnext)
+    if(*pp == p){
+      *pp = p->hnext;  // p->hnext stays, for lookups now at p
+      break;
+    }
+  __sync_synchronize();
+  p->retired = epoch++;
+
+  kfree(p->kstack);
+  p->kstack = 0;
+  kfree((char*)p->vproc);
+  p->vproc = 0;
+  freevm(p->pgdir);
+  p->pid = 0;
+  p->parent = 0;
+  p->name[0] = 0;
+  p->killed = 0;
+  p->state = UNUSED;
+}
+
 //PAGEBREAK: 32
 // Look in the process table for an UNUSED proc.
 // If found, change state to EMBRYO and initialize
@@ -84,19 +182,30 @@ allocproc(void)
 {
   struct proc *p;
   char *sp;
+  int recent;
 
-  acquire(&ptable.lock);
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  release(&ptable.lock);
-  return 0;
+  // Skip slots a pid lookup may still be looking at,
+  // and try again if those were the only free ones.
+  for(;;){
+    acquire(&ptable.lock);
+    recent = 0;
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+      if(p->state != UNUSED)
+        continue;
+      if(rcudone(p->retired))
+        goto found;
+      recent = 1;
+    }
+    release(&ptable.lock);
+    if(!recent)
+      return 0;
+    pause();
+  }
 
 found:
   p->state = EMBRYO;
   p->pid = nextpid++;
+  p->killed = 0;
 
   release(&ptable.lock);
 
@@ -105,6 +214,16 @@ found:
     p->state = UNUSED;
     return 0;
   }
+
+  // Allocate the page mapped read-only at VPROC.
+  if((p->vproc = (struct vproc*)kalloc()) == 0){
+    kfree(p->kstack);
+    p->kstack = 0;
+    p->state = UNUSED;
+    return 0;
+  }
+  memset(p->vproc, 0, PGSIZE);
+  p->vproc->pid = p->pid;
   sp = p->kstack + KSTACKSIZE;
 
   // Leave room for trap frame.
@@ -120,6 +239,7 @@ found:
   p->context = (struct context*)sp;
   memset(p->context, 0, sizeof *p->context);
   p->context->eip = (uint)forkret;
+  p->ring = 0;
 
   // initialize time variables for waitx
   acquire(&tickslock);
@@ -157,7 +277,10 @@ found:
     p->ticks[i] = -1;
     #endif
   }
-  
+
+  // For getrusage
+  memset(&p->ru, 0, sizeof(p->ru));
+  memset(&p->cru, 0, sizeof(p->cru));
 
   return p;
 }
@@ -261,6 +384,8 @@ userinit(void)
   if((p->pgdir = setupkvm()) == 0)
     panic("userinit: out of memory?");
   inituvm(p->pgdir, _binary_initcode_start, (int)_binary_initcode_size);
+  if(vdsomap(p->pgdir, p->vproc) < 0)
+    panic("userinit: vdsomap");
   p->sz = PGSIZE;
   memset(p->tf, 0, sizeof(*p->tf));
   p->tf->cs = (SEG_UCODE << 3) | DPL_USER;
@@ -281,6 +406,7 @@ userinit(void)
   acquire(&ptable.lock);
 
   p->state = RUNNABLE;
+  hashproc(p);
   // For MLFQ
   #if SCHEDULER == SCHED_MLFQ
   p->enter_time = ticks;
@@ -307,6 +433,8 @@ growproc(int n)
       return -1;
   }
   curproc->sz = sz;
+  if(sz > curproc->ru.maxsz)
+    curproc->ru.maxsz = sz;
   switchuvm(curproc);
   return 0;
 }
@@ -327,14 +455,21 @@ fork(void)
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
+  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0 ||
+     vdsomap(np->pgdir, np->vproc) < 0){
+    if(np->pgdir)
+      freevm(np->pgdir);
     kfree(np->kstack);
     np->kstack = 0;
+    kfree((char*)np->vproc);
+    np->vproc = 0;
     np->state = UNUSED;
     return -1;
   }
   np->sz = curproc->sz;
+  np->ru.maxsz = np->sz;
   np->parent = curproc;
+  np->vproc->ppid = curproc->pid;
   *np->tf = *curproc->tf;
 
   // Clear %eax so that fork returns 0 in the child.
@@ -344,6 +479,7 @@ fork(void)
     if(curproc->ofile[i])
       np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
+  np->ring = curproc->ring;
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
@@ -352,6 +488,7 @@ fork(void)
   acquire(&ptable.lock);
 
   np->state = RUNNABLE;
+  hashproc(np);
   // For MLFQ
   #if SCHEDULER == SCHED_MLFQ
   np->enter_time = ticks;
@@ -363,6 +500,48 @@ fork(void)
   return pid;
 }
 
+// Start a kernel-only process that runs fn().
+// It has no user memory, never returns to user space
+// and has no parent, so fn() must never return.
+// Returns the pid, or -1 if no process slot is free.
+int
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *np;
+
+  if((np = allocproc()) == 0)
+    return -1;
+  if((np->pgdir = setupkvm()) == 0){
+    kfree(np->kstack);
+    np->kstack = 0;
+    kfree((char*)np->vproc);
+    np->vproc = 0;
+    np->state = UNUSED;
+    return -1;
+  }
+  np->sz = 0;
+  np->parent = 0;
+  np->cwd = 0;
+  safestrcpy(np->name, name, sizeof(np->name));
+
+  // forkret() returns into fn() instead of trapret.
+  *(uint*)((char*)np->context + sizeof(*np->context)) = (uint)fn;
+
+  acquire(&ptable.lock);
+
+  np->state = RUNNABLE;
+  hashproc(np);
+  // For MLFQ
+  #if SCHEDULER == SCHED_MLFQ
+  np->enter_time = ticks;
+  queues[0] = push(queues[0], np);
+  #endif
+
+  release(&ptable.lock);
+
+  return np->pid;
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait() to find out it exited.
@@ -401,6 +580,7 @@ exit(void)
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
     if(p->parent == curproc){
       p->parent = initproc;
+      p->vproc->ppid = initproc->pid;
       if(p->state == ZOMBIE)
         wakeup1(initproc);
     }
@@ -412,34 +592,102 @@ exit(void)
   panic("zombie exit");
 }
 
-// Wait for a child process to exit and return its pid.
-// Return -1 if this process has no children.
-int
-wait(void)
+// Charge the time since the current process was last
+// charged to its user time if user is set, else to its
+// system time. trap() calls it on the way in from and out
+// to user space, and sched() on the way to the scheduler.
+void
+rucharge(int user)
 {
   struct proc *p;
-  int havekids, pid;
+  uint now;
+
+  pushcli();
+  p = myproc();
+  now = rdtsc();
+  if(user)
+    p->ru.utsc += now - p->tsc;
+  else
+    p->ru.stsc += now - p->tsc;
+  p->tsc = now;
+  popcli();
+}
+
+// Add usage u into *to.
+static void
+usageadd(struct usage *to, struct usage *u)
+{
+  to->utsc += u->utsc;
+  to->stsc += u->stsc;
+  to->nvcsw += u->nvcsw;
+  to->nivcsw += u->nivcsw;
+  to->nfault += u->nfault;
+  to->inblock += u->inblock;
+  to->oublock += u->oublock;
+  if(u->maxsz > to->maxsz)
+    to->maxsz = u->maxsz;
+}
+
+// Copy usage u out as r.
+static void
+usagecopy(struct rusage *r, struct usage *u)
+{
+  r->utime = tscus(u->utsc);
+  r->stime = tscus(u->stsc);
+  r->nvcsw = u->nvcsw;
+  r->nivcsw = u->nivcsw;
+  r->nfault = u->nfault;
+  r->inblock = u->inblock;
+  r->oublock = u->oublock;
+  r->maxrss = u->maxsz / 1024;
+}
+
+// Wait for a child process to exit and return its pid,
+// storing its times in *wtime and *rtime and its usage,
+// with that of the children it waited for, in *ru if
+// they are not 0. Waits for any child if pid <= 0.
+// Return -1 if this process has no such children.
+static int
+waitchild(int pid, int *wtime, int *rtime, struct rusage *ru)
+{
+  struct proc *p;
+  struct usage u;
+  int havekids;
   struct proc *curproc = myproc();
-  
+
+  // Only this process gives itself children, and only exit()
+  // hands them to init, so unless this is init a scan without
+  // the lock can tell there are none.
+  if(curproc != initproc){
+    havekids = 0;
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+      if(p->parent == curproc && (pid <= 0 || p->pid == pid))
+        havekids = 1;
+    if(!havekids)
+      return -1;
+  }
+
   acquire(&ptable.lock);
   for(;;){
     // Scan through table looking for exited children.
     havekids = 0;
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
+      if(p->parent != curproc || (pid > 0 && p->pid != pid))
         continue;
       havekids = 1;
       if(p->state == ZOMBIE){
         // Found one.
+        if(rtime)
+          *rtime = p->rtime;
+        if(wtime)
+          *wtime = p->etime - p->rtime - p->iotime - p->ctime;
+        u = p->ru;
+        usageadd(&u, &p->cru);
+        usageadd(&curproc->cru, &u);
+        if(ru)
+          usagecopy(ru, &u);
         pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
+        freeproc(p);
         release(&ptable.lock);
         return pid;
       }
@@ -456,61 +704,81 @@ wait(void)
   }
 }
 
+int
+wait(void)
+{
+  return waitchild(0, 0, 0, 0);
+}
+
 int
 waitx(int *wtime, int *rtime)
 {
-  struct proc *p;
-  int havekids, pid;
-  struct proc *curproc = myproc();
-  
-  acquire(&ptable.lock);
-  for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
-      if(p->state == ZOMBIE){
-        // Found one.
-        *rtime = p->rtime;
-        *wtime = p->etime - p->rtime - p->iotime - p->ctime;
-        pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
-        release(&ptable.lock);
-        return pid;
-      }
-    }
+  return waitchild(0, wtime, rtime, 0);
+}
 
-    // No point waiting if we don't have any children.
-    if(!havekids || curproc->killed){
-      release(&ptable.lock);
-      return -1;
-    }
+// Like wait(), but only for child pid if pid > 0, and
+// store the usage of the child and its children in *ru.
+int
+wait4(int pid, struct rusage *ru)
+{
+  return waitchild(pid, 0, 0, ru);
+}
 
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
-    sleep(curproc, &ptable.lock);  //DOC: wait-sleep
-  }
+// Store the usage of the current process, or of its children
+// that it has waited for, in *ru.
+int
+getrusage(int who, struct rusage *ru)
+{
+  struct proc *p = myproc();
+
+  if(who == RUSAGE_SELF){
+    rucharge(0);
+    usagecopy(ru, &p->ru);
+  } else if(who == RUSAGE_CHILDREN)
+    usagecopy(ru, &p->cru);
+  else
+    return -1;
+  return 0;
 }
 
+// Copy up to n processes into pi, all as of one moment.
+// Returns the number of processes, which may be more than n.
 int
-my_ps()
+getprocs(struct procinfo *pi, int n)
 {
-  struct proc* p;
-  cprintf("PID\tPriority\tState\t\tr_time\tw_time\tn_run\tcur_q\tq0\tq1\tq2\tq3\tq4\n");
+  struct proc *p;
+  struct cpu *c;
+  int i, m;
+
+  m = 0;
+  acquire(&ptable.lock);
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    char *states[] = { "UNUSED\t", "EMBRYO\t", "SLEEPING", "RUNNABLE", "RUNNING\t", "ZOMBIE\t" };
-    if(p->state != UNUSED)
-      cprintf("%d\t%d\t\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n", p->pid, p->priority, states[p->state], p->rtime, p->cur_waiting_time, p->n_run, p->queue_no, p->ticks[0], p->ticks[1], p->ticks[2], p->ticks[3], p->ticks[4]);
+    if(p->state == UNUSED)
+      continue;
+    if(m++ >= n)
+      continue;
+    pi->pid = p->pid;
+    pi->ppid = p->parent ? p->parent->pid : 0;
+    pi->state = p->state;
+    safestrcpy(pi->name, p->name, sizeof(pi->name));
+    pi->sz = p->sz;
+    pi->cpu = -1;
+    for(c = cpus; c < &cpus[ncpu]; c++)
+      if(c->proc == p)
+        pi->cpu = c - cpus;
+    pi->priority = p->priority;
+    pi->queue = p->queue_no;
+    pi->ctime = p->ctime;
+    pi->rtime = p->rtime;
+    pi->iotime = p->iotime;
+    pi->wtime = p->cur_waiting_time;
+    pi->n_run = p->n_run;
+    for(i = 0; i < 5; i++)
+      pi->ticks[i] = p->ticks[i];
+    pi++;
   }
-  return 0;
+  release(&ptable.lock);
+  return m;
 }
 
 //PAGEBREAK: 42
@@ -541,9 +809,7 @@ scheduler(void)
         if(p->state != RUNNABLE)
           continue;
 
-        // #ifdef DEBUG
-        //   cprintf("On core: %d\nScheduling\nProcess name: %s with pid: %d and creation time: %d\n", c->apicid, p->name, p->pid, p->ctime);
-        // #endif
+        TRACE(TR_SCHED, p->pid, 0);
 
         // Switch to chosen process.  It is the process's job
         // to release ptable.lock and then reacquire it
@@ -590,9 +856,7 @@ scheduler(void)
         continue;
       }
 
-      #ifdef DEBUG
-        cprintf("On core: %d\nScheduling\nProcess name: %s with pid: %d and creation time: %d\n", c->apicid, proc_selected->name, proc_selected->pid, proc_selected->ctime);
-      #endif
+      TRACE(TR_SCHED, proc_selected->pid, 0);
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
       // before jumping back to us.
@@ -639,11 +903,9 @@ scheduler(void)
         continue;
       }
 
-      #ifdef DEBUG
-        cprintf("On core: %d\nScheduling\nProcess name: %s with pid: %d and priority: %d\n", c->apicid, proc_selected->name, proc_selected->pid, proc_selected->priority);
-      #endif
+      TRACE(TR_SCHED, proc_selected->pid, 0);
       // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire itcprintf("On core: %d\nScheduling\nProcess name: %s with pid: %d and priority: %d\n", c->apicid, proc_selected->name, proc_selected->pid, proc_selected->priority);
+      // to release ptable.lock and then reacquire it
       // before jumping back to us.
       proc_selected->chance++;
       proc_selected->cur_waiting_time = 0;
@@ -700,10 +962,8 @@ scheduler(void)
     {
       while((length(queues[i]) > 0) && (ticks - queues[i]->data->enter_time > 30))
       {
-        #ifdef DEBUG
-        cprintf("Pid: %d is promoted from queue number: %d\n", queues[i]->data->pid, queues[i]->data->queue_no);
-        #endif
         struct proc* temp = queues[i]->data;
+        TRACE(TR_PROMOTE, temp->pid, temp->queue_no - 1);
         queues[i] = pop(queues[i]);
         temp->cur_waiting_time = 0;
         temp->cur_ticks = 0;
@@ -728,6 +988,7 @@ scheduler(void)
       release(&ptable.lock);
       continue;
     }
+    TRACE(TR_SCHED, selected_proc->pid, 0);
 
     // Switch to chosen process.  It is the process's job
     // to release ptable.lock and then reacquire it
@@ -757,10 +1018,8 @@ scheduler(void)
       selected_proc->change_queue = 0;
       if(selected_proc->queue_no != 4)
       {
-        #ifdef DEBUG
-        cprintf("Pid: %d is demoted from queue number: %d\n", selected_proc->pid, selected_proc->queue_no);
-        #endif
         selected_proc->queue_no++;
+        TRACE(TR_DEMOTE, selected_proc->pid, selected_proc->queue_no);
       }
       queues[selected_proc->queue_no] = push(queues[selected_proc->queue_no], selected_proc);
     }
@@ -792,45 +1051,39 @@ sched(void)
     panic("sched running");
   if(readeflags()&FL_IF)
     panic("sched interruptible");
+  if(p->state == SLEEPING)
+    p->ru.nvcsw++;
+  else if(p->state == RUNNABLE)
+    p->ru.nivcsw++;
+  rucharge(0);
   intena = mycpu()->intena;
   swtch(&p->context, mycpu()->scheduler);
   mycpu()->intena = intena;
+  p->tsc = rdtsc();
 }
 
+// Set the priority of process pid, found without ptable.lock;
+// the scheduler reads the new value on its next pass.
 int
 set_priority(int new_priority, int pid)
 {
   struct proc *p;
-  struct proc *curr_proc = 0;
   int old_priority;
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid)
-    {
-      curr_proc = p;
-      break;
-    }
-  }
-  if(curr_proc == 0)
-  {
-    release(&ptable.lock);
-    return -1;
-  }
+
   if(new_priority > 100 || new_priority < 0)
-  {
-    release(&ptable.lock);
+    return -1;
+  rcubegin();
+  if((p = pidlookup(pid)) == 0){
+    rcuend();
     return -1;
   }
-  old_priority = curr_proc->priority;
-  curr_proc->priority = new_priority;
+  old_priority = p->priority;
+  p->priority = new_priority;
 
-  #ifdef DEBUG
-    cprintf("Process with id %d and name %s changed its priority from %d to %d\n",curr_proc->pid, curr_proc->name, old_priority, new_priority);
-  #endif
-
-  curr_proc->chance = 0;
-  release(&ptable.lock);
-  if(curr_proc->priority < old_priority)
+  TRACE(TR_PRIORITY, p->pid, new_priority);
+  p->chance = 0;
+  rcuend();
+  if(new_priority < old_priority)
   {
     yield();
   }
@@ -855,6 +1108,7 @@ forkret(void)
   static int first = 1;
   // Still holding ptable.lock from scheduler.
   release(&ptable.lock);
+  myproc()->tsc = rdtsc();
 
   if (first) {
     // Some initialization functions must be run in the context
@@ -863,6 +1117,7 @@ forkret(void)
     first = 0;
     iinit(ROOTDEV);
     initlog(ROOTDEV);
+    allocinit(ROOTDEV);
   }
 
   // Return to "caller", actually trapret (see allocproc).
@@ -894,6 +1149,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  TRACE(TR_SLEEP, (uint)chan, 0);
 
   sched();
 
@@ -919,7 +1175,7 @@ wakeup1(void *chan)
     if(p->state == SLEEPING && p->chan == chan)
     {
       p->state = RUNNABLE;
-      // cprintf("Inside wakeup1, pid: %d name: %s", p->pid,p->name);
+      TRACE(TR_WAKEUP, p->pid, (uint)chan);
       #if SCHEDULER == SCHED_MLFQ
       p->cur_ticks = 0;
       p->enter_time = ticks;
@@ -938,35 +1194,61 @@ wakeup(void *chan)
   release(&ptable.lock);
 }
 
+// Wake up one of the processes sleeping on chan.
+void
+wakeupone(void *chan)
+{
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->state == SLEEPING && p->chan == chan)
+    {
+      p->state = RUNNABLE;
+      TRACE(TR_WAKEUP, p->pid, (uint)chan);
+      #if SCHEDULER == SCHED_MLFQ
+      p->cur_ticks = 0;
+      p->enter_time = ticks;
+      p->change_queue = 0;
+      queues[p->queue_no] = push(queues[p->queue_no], p);
+      #endif
+      break;
+    }
+  release(&ptable.lock);
+}
+
 // Kill the process with the given pid.
 // Process won't exit until it returns
 // to user space (see trap in trap.c).
+// Takes ptable.lock only to wake a sleeping process.
 int
 kill(int pid)
 {
   struct proc *p;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-      {
-        p->state = RUNNABLE;
-        #if SCHEDULER == SCHED_MLFQ
-        p->cur_ticks = 0;
-        p->enter_time = ticks;
-        p->change_queue = 0;
-        queues[p->queue_no] = push(queues[p->queue_no], p);
-        #endif
-      }
-      release(&ptable.lock);
-      return 0;
+  rcubegin();
+  if((p = pidlookup(pid)) == 0){
+    rcuend();
+    return -1;
+  }
+  p->killed = 1;
+  // Wake process from sleep if necessary.
+  if(p->state == SLEEPING){
+    acquire(&ptable.lock);
+    if(p->pid == pid && p->state == SLEEPING)
+    {
+      p->state = RUNNABLE;
+      #if SCHEDULER == SCHED_MLFQ
+      p->cur_ticks = 0;
+      p->enter_time = ticks;
+      p->change_queue = 0;
+      queues[p->queue_no] = push(queues[p->queue_no], p);
+      #endif
     }
+    release(&ptable.lock);
   }
-  release(&ptable.lock);
-  return -1;
+  rcuend();
+  return 0;
 }
 
 //PAGEBREAK: 36
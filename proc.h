@@ -8,6 +8,7 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  volatile uint rcuepoch;      // Epoch its pid lookup began in, or 0
 };
 
 extern struct cpu cpus[NCPU];
@@ -32,6 +33,18 @@ struct context {
   uint eip;
 };
 
+// Resource usage, see getrusage().
+struct usage {
+  unsigned long long utsc;     // TSC cycles in user mode
+  unsigned long long stsc;     // TSC cycles in the kernel
+  uint nvcsw;                  // Sleeps
+  uint nivcsw;                 // Preemptions
+  uint nfault;                 // Page faults
+  uint inblock;                // Blocks read from disk
+  uint oublock;                // Blocks written to disk
+  uint maxsz;                  // Largest sz
+};
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -41,6 +54,8 @@ struct proc {
   char *kstack;                // Bottom of kernel stack for this process
   enum procstate state;        // Process state
   int pid;                     // Process ID
+  struct proc *hnext;          // Next in pid hash chain
+  uint retired;                // Epoch when last freed
   struct proc *parent;         // Parent process
   struct trapframe *tf;        // Trap frame for current syscall
   struct context *context;     // swtch() here to run process
@@ -48,6 +63,9 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  int logblocks;               // Log blocks reserved by begin_opn()
+  struct io_ring *ring;        // Rings from ioring_setup(), or 0
+  struct vproc *vproc;         // Page mapped read-only at VPROC
   char name[16];               // Process name (debugging)
 
   // For waitx
@@ -70,6 +88,11 @@ struct proc {
   int n_run;
   int ticks[5];
   int cur_waiting_time;
+
+  // For getrusage
+  struct usage ru;             // Own usage
+  struct usage cru;            // Usage of waited-for children
+  uint tsc;                    // TSC when time was last charged
 };
 
 // Process memory is laid out contiguously, low addresses first:
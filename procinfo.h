@@ -0,0 +1,18 @@
+// A process, as copied out by the getprocs system call.
+// Fields that the running scheduler does not use are -1.
+struct procinfo {
+  int pid;
+  int ppid;         // parent's pid, 0 if none
+  int state;        // enum procstate in proc.h
+  char name[16];
+  uint sz;          // user memory, in bytes
+  int cpu;          // CPU running it, or -1
+  int priority;     // PBS priority
+  int queue;        // MLFQ queue
+  int ctime;        // tick it was created
+  int rtime;        // ticks running
+  int iotime;       // ticks sleeping
+  int wtime;        // ticks runnable since it last ran
+  int n_run;        // times scheduled
+  int ticks[5];     // ticks run in each MLFQ queue
+};
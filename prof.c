@@ -0,0 +1,230 @@
+// Sampling profiler: run a command with the kernel profiler
+// on, then print a flat profile of where the CPUs were, by
+// function. "self" counts samples in a function, "total"
+// also counts samples in the functions it called, as far as
+// the recorded call chains reach. Functions are looked up in
+// /kernel.sym and /prog.sym. Time the CPUs spent idle in the
+// scheduler is only counted.
+// Usage: prof cmd [args]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "profile.h"
+
+#define MAXSAMPLES 20000
+#define NTAB 16    // programs whose symbols are loaded
+#define NFN 512    // functions counted
+
+struct sym {
+  uint addr;
+  char *name;
+};
+
+struct symtab {
+  char prog[16];
+  struct sym *sym;
+  int nsym;
+} tab[NTAB];
+int ntab;
+
+struct fn {
+  struct symtab *t;
+  char *name;
+  int self;
+  int total;
+} fn[NFN];
+int nfn;
+
+struct profsample *samples;
+int nsamples;
+
+uint
+hex(char *s)
+{
+  uint x;
+
+  x = 0;
+  for(;; s++){
+    if(*s >= '0' && *s <= '9')
+      x = x*16 + *s - '0';
+    else if(*s >= 'a' && *s <= 'f')
+      x = x*16 + *s - 'a' + 10;
+    else
+      return x;
+  }
+}
+
+// Read the symbols of prog, sorted by address. Names with a
+// dot are sections, files or local labels, and are skipped.
+struct symtab*
+loadsyms(char *prog)
+{
+  struct symtab *t;
+  struct stat st;
+  struct sym s;
+  char path[32], *buf, *p, *q;
+  int fd, i, j, n;
+
+  for(t = tab; t < &tab[ntab]; t++)
+    if(strcmp(t->prog, prog) == 0)
+      return t;
+  if(ntab == NTAB)
+    return 0;
+  t = &tab[ntab++];
+  strcpy(t->prog, prog);
+  t->nsym = 0;
+  strcpy(path, "/");
+  strcpy(path + 1, prog);
+  strcpy(path + strlen(path), ".sym");
+  if((fd = open(path, O_RDONLY)) < 0)
+    return t;
+  if(fstat(fd, &st) < 0 || (buf = malloc(st.size + 1)) == 0){
+    close(fd);
+    return t;
+  }
+  n = read(fd, buf, st.size);
+  close(fd);
+  if(n < 0)
+    n = 0;
+  buf[n] = 0;
+
+  j = 0;
+  for(p = buf; *p; p++)
+    if(*p == '\n')
+      j++;
+  t->sym = malloc((j + 1) * sizeof(struct sym));
+  for(p = buf; *p; p = q){
+    if((q = strchr(p, '\n')) == 0)
+      q = p + strlen(p);
+    else
+      *q++ = 0;
+    if(strchr(p, ' ') == 0)
+      continue;
+    s.addr = hex(p);
+    s.name = strchr(p, ' ') + 1;
+    if(strchr(s.name, '.'))
+      continue;
+    for(i = t->nsym++; i > 0 && t->sym[i-1].addr > s.addr; i--)
+      t->sym[i] = t->sym[i-1];
+    t->sym[i] = s;
+  }
+  return t;
+}
+
+// Count a sample at pc in t's program: in self if
+// self is set, and once per sample in total.
+void
+count(struct symtab *t, uint pc, int self, struct fn **seen, int *nseen)
+{
+  char *name;
+  struct fn *f;
+  int lo, hi, mid, i;
+
+  name = "?";
+  lo = 0;
+  hi = t ? t->nsym : 0;
+  while(hi - lo > 1){
+    mid = (lo + hi) / 2;
+    if(t->sym[mid].addr <= pc)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  if(hi > 0 && t->sym[lo].addr <= pc)
+    name = t->sym[lo].name;
+
+  for(f = fn; f < &fn[nfn]; f++)
+    if(f->t == t && strcmp(f->name, name) == 0)
+      break;
+  if(f == &fn[nfn]){
+    if(nfn == NFN)
+      return;
+    nfn++;
+    f->t = t;
+    f->name = name;
+    f->self = f->total = 0;
+  }
+  if(self)
+    f->self++;
+  for(i = 0; i < *nseen; i++)
+    if(seen[i] == f)
+      return;
+  seen[(*nseen)++] = f;
+  f->total++;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct profsample *s;
+  struct symtab *t;
+  struct fn *seen[PROFDEPTH+1], tmp;
+  int fds[2], i, j, n, nseen, idle, lost;
+  char c;
+
+  if(argc < 2){
+    printf(2, "usage: prof cmd [args]\n");
+    exit();
+  }
+  samples = malloc(MAXSAMPLES * sizeof(struct profsample));
+  if(samples == 0 || pipe(fds) < 0){
+    printf(2, "prof: out of memory\n");
+    exit();
+  }
+
+  // The child holds the write end of the pipe until it
+  // exits, so a read that ends the pipe says it is done.
+  profile(1);
+  if((i = fork()) < 0){
+    printf(2, "prof: fork failed\n");
+    exit();
+  }
+  if(i == 0){
+    close(fds[0]);
+    exec(argv[1], argv + 1);
+    printf(2, "prof: exec %s failed\n", argv[1]);
+    exit();
+  }
+  close(fds[1]);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  do {
+    sleep(1);
+    if(nsamples < MAXSAMPLES)
+      nsamples += profread(samples + nsamples, MAXSAMPLES - nsamples);
+  } while(read(fds[0], &c, 1) != 0);
+  lost = profile(0);
+  if(nsamples < MAXSAMPLES)
+    nsamples += profread(samples + nsamples, MAXSAMPLES - nsamples);
+  wait();
+
+  idle = 0;
+  for(s = samples; s < samples + nsamples; s++){
+    if(s->pid == 0){
+      idle++;
+      continue;
+    }
+    t = loadsyms(s->user ? s->name : "kernel");
+    nseen = 0;
+    count(t, s->eip, 1, seen, &nseen);
+    for(j = 0; j < PROFDEPTH && s->pcs[j]; j++)
+      count(t, s->pcs[j], 0, seen, &nseen);
+  }
+  for(i = 1; i < nfn; i++){
+    tmp = fn[i];
+    for(j = i; j > 0 && fn[j-1].self < tmp.self; j--)
+      fn[j] = fn[j-1];
+    fn[j] = tmp;
+  }
+
+  n = nsamples - idle;
+  printf(1, "%d samples, %d idle, %d lost\n", nsamples, idle, lost);
+  if(n == 0)
+    exit();
+  printf(1, "self%%  total%%  samples  function\n");
+  for(i = 0; i < nfn; i++)
+    printf(1, "%d  %d  %d  %s:%s\n", fn[i].self*100/n, fn[i].total*100/n,
+      fn[i].self, fn[i].t ? fn[i].t->prog : "?", fn[i].name);
+  exit();
+}
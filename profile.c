@@ -0,0 +1,127 @@
+//
+// Sampling profiler. While it is on, every CPU records where
+// each of its timer interrupts landed, and the callers found
+// by following the frame pointers from there, into its own
+// ring. Only that CPU adds to its ring, with interrupts off;
+// profread() takes samples out under prof.lock. A full ring
+// drops new samples until it is drained.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "profile.h"
+
+struct profring {
+  uint head;   // samples added
+  uint tail;   // samples taken out
+  uint lost;   // samples dropped while full
+  struct profsample s[PROFN];
+};
+
+static struct {
+  struct spinlock lock;
+  int on;
+  struct profring ring[NCPU];
+} prof;
+
+void
+profinit(void)
+{
+  initlock(&prof.lock, "prof");
+}
+
+// Record a sample of the code interrupted by the timer
+// interrupt tf, if the profiler is on.
+void
+proftick(struct trapframe *tf)
+{
+  struct profring *r;
+  struct profsample *s;
+  struct proc *p;
+  uint *fp;
+  int i;
+
+  if(!prof.on)
+    return;
+  r = &prof.ring[cpuid()];
+  if(r->head - r->tail == PROFN){
+    r->lost++;
+    return;
+  }
+  s = &r->s[r->head % PROFN];
+  p = myproc();
+  s->eip = tf->eip;
+  s->user = (tf->cs&3) == DPL_USER;
+  s->cpu = cpuid();
+  s->pid = p ? p->pid : 0;
+  safestrcpy(s->name, p ? p->name : "", sizeof(s->name));
+
+  // A user frame pointer is only followed within the process's
+  // memory, which is all mapped, so a bad one cannot fault.
+  fp = (uint*)tf->ebp;
+  for(i = 0; i < PROFDEPTH; i++){
+    if(s->user){
+      if(p == 0 || fp == 0 || (uint)fp >= p->sz || p->sz - (uint)fp < 8)
+        break;
+    } else if((uint)fp < KERNBASE || (uint)fp > 0xfffffff8)
+      break;
+    s->pcs[i] = fp[1];
+    fp = (uint*)fp[0];
+  }
+  for(; i < PROFDEPTH; i++)
+    s->pcs[i] = 0;
+
+  __sync_synchronize();  // profread() must see the sample first
+  r->head++;
+}
+
+// Turn the profiler on or off. Turning it on throws away
+// samples not yet read. Returns the number of samples
+// dropped since it was last turned on.
+int
+profile(int on)
+{
+  struct profring *r;
+  uint lost;
+
+  acquire(&prof.lock);
+  lost = 0;
+  for(r = prof.ring; r < &prof.ring[NCPU]; r++){
+    lost += r->lost;
+    if(on){
+      r->tail = r->head;
+      r->lost = 0;
+    }
+  }
+  prof.on = on;
+  release(&prof.lock);
+  return lost;
+}
+
+// Move up to n samples, from all CPUs, into s.
+// Returns the number moved.
+int
+profread(struct profsample *s, int n)
+{
+  struct profring *r;
+  int m;
+
+  m = 0;
+  acquire(&prof.lock);
+  for(r = prof.ring; r < &prof.ring[NCPU]; r++){
+    while(m < n && r->tail != r->head){
+      __sync_synchronize();
+      s[m++] = r->s[r->tail % PROFN];
+      __sync_synchronize();
+      r->tail++;
+    }
+  }
+  release(&prof.lock);
+  return m;
+}
@@ -0,0 +1,12 @@
+// Samples taken by the profiler, see profile.c.
+#define PROFDEPTH 4  // callers kept per sample
+#define PROFN 128    // samples kept per CPU
+
+struct profsample {
+  uint eip;              // Interrupted instruction
+  uint pcs[PROFDEPTH];   // Return addresses of its callers, 0 after the last
+  int pid;               // Process interrupted, or 0 for the scheduler
+  int cpu;               // CPU that took the sample
+  int user;              // Interrupted in user mode?
+  char name[16];         // Process name
+};
@@ -1,10 +1,109 @@
+// List processes.
+// Usage: ps [-s key] [-r] [-p pid] [-n name] [-S state]
+//   -s  sort by pid (default), ppid, size, rtime, wtime,
+//       iotime, nrun, prio or queue
+//   -r  reverse the order
+//   -p, -n, -S  show only the process with that pid,
+//       those with that name, or those in that state
+
 #include "types.h"
 #include "stat.h"
 #include "user.h"
-#include "fs.h"
+#include "procinfo.h"
+
+#define NPS 64
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+struct procinfo ps[NPS];
+
+// Names of enum procstate in proc.h.
+char *states[] = { "unused", "embryo", "sleep", "runnable", "running", "zombie" };
+
+char *keys[] = { "pid", "ppid", "size", "rtime", "wtime", "iotime", "nrun", "prio", "queue" };
+
+int
+key(struct procinfo *p, int k)
+{
+  switch(k){
+  case 1: return p->ppid;
+  case 2: return p->sz;
+  case 3: return p->rtime;
+  case 4: return p->wtime;
+  case 5: return p->iotime;
+  case 6: return p->n_run;
+  case 7: return p->priority;
+  case 8: return p->queue;
+  }
+  return p->pid;
+}
+
+void
+usage(void)
+{
+  printf(2, "usage: ps [-s key] [-r] [-p pid] [-n name] [-S state]\n");
+  exit();
+}
 
-int main(int argc, char** argv)
+int
+main(int argc, char *argv[])
 {
-    my_ps();
+  struct procinfo t, *p;
+  int i, j, n, k, rev, pid, state;
+  char *name;
+
+  k = rev = pid = 0;
+  state = -1;
+  name = 0;
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-r") == 0){
+      rev = 1;
+      continue;
+    }
+    if(i + 1 == argc)
+      usage();
+    if(strcmp(argv[i], "-s") == 0){
+      for(k = 0; k < NELEM(keys) && strcmp(keys[k], argv[i+1]) != 0; k++)
+        ;
+      if(k == NELEM(keys))
+        usage();
+    } else if(strcmp(argv[i], "-p") == 0)
+      pid = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "-n") == 0)
+      name = argv[i+1];
+    else if(strcmp(argv[i], "-S") == 0){
+      for(state = 0; state < NELEM(states) && strcmp(states[state], argv[i+1]) != 0; state++)
+        ;
+      if(state == NELEM(states))
+        usage();
+    } else
+      usage();
+    i++;
+  }
+
+  if((n = getprocs(ps, NPS)) < 0){
+    printf(2, "ps: getprocs failed\n");
     exit();
-}
\ No newline at end of file
+  }
+  if(n > NPS)
+    n = NPS;
+  for(i = 1; i < n; i++){
+    t = ps[i];
+    for(j = i; j > 0 && (key(&ps[j-1], k) > key(&t, k)) != rev &&
+        key(&ps[j-1], k) != key(&t, k); j--)
+      ps[j] = ps[j-1];
+    ps[j] = t;
+  }
+
+  printf(1, "PID\tPPID\tSTATE\t\tPRI\tQ\tCPU\tSIZE\tRTIME\tWTIME\tIOTIME\tNRUN\tQ0\tQ1\tQ2\tQ3\tQ4\tNAME\n");
+  for(p = ps; p < &ps[n]; p++){
+    if((pid && p->pid != pid) || (name && strcmp(p->name, name) != 0) ||
+       (state >= 0 && p->state != state))
+      continue;
+    printf(1, "%d\t%d\t%s\t%s%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%s\n",
+      p->pid, p->ppid, states[p->state], strlen(states[p->state]) < 8 ? "\t" : "",
+      p->priority, p->queue, p->cpu, p->sz, p->rtime, p->wtime, p->iotime,
+      p->n_run, p->ticks[0], p->ticks[1], p->ticks[2], p->ticks[3],
+      p->ticks[4], p->name);
+  }
+  exit();
+}
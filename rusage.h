@@ -0,0 +1,14 @@
+// Resource usage, from the getrusage and wait4 system calls.
+#define RUSAGE_SELF      0
+#define RUSAGE_CHILDREN  (-1)  // children that have been waited for
+
+struct rusage {
+  uint utime;    // microseconds in user mode
+  uint stime;    // microseconds in the kernel
+  uint nvcsw;    // times it gave up the CPU to sleep
+  uint nivcsw;   // times it was preempted
+  uint nfault;   // page faults
+  uint inblock;  // blocks read from disk
+  uint oublock;  // blocks written to disk
+  uint maxrss;   // largest memory size, in KB
+};
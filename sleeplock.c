@@ -10,6 +10,8 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 
+#define SLEEPSPIN 10000  // longest spin, in pause()s, for a running owner
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
@@ -17,17 +19,60 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->owner = 0;
+  lk->nwait = 0;
+#ifdef LOCKSTAT
+  lk->stat = lockclass(name, 1);
+#endif
 }
 
+// If the holder is running on another CPU it will probably
+// release the lock soon, so spin for a while, with lk->lk
+// released, before going to sleep.
 void
 acquiresleep(struct sleeplock *lk)
 {
+  struct proc *o;
+  int n, spun;
+#ifdef LOCKSTAT
+  uint t0;
+  int w;
+#endif
+
   acquire(&lk->lk);
+#ifdef LOCKSTAT
+  t0 = rdtsc();
+  w = lk->locked;
+#endif
+  spun = 0;
   while (lk->locked) {
+    o = lk->owner;
+    if(!spun && o && o->state == RUNNING){
+      spun = 1;
+      release(&lk->lk);
+      for(n = 0; n < SLEEPSPIN; n++){
+        // Nothing below writes memory, so without volatile
+        // the compiler could read these just once.
+        if(*(volatile uint*)&lk->locked == 0 ||
+           *(struct proc *volatile*)&lk->owner != o ||
+           *(volatile enum procstate*)&o->state != RUNNING)
+          break;
+        pause();
+      }
+      acquire(&lk->lk);
+      continue;
+    }
+    lk->nwait++;
     sleep(lk, &lk->lk);
+    lk->nwait--;
   }
   lk->locked = 1;
-  lk->pid = myproc()->pid;
+  lk->owner = myproc();
+  lk->pid = lk->owner->pid;
+#ifdef LOCKSTAT
+  lk->tacq = rdtsc();
+  lockstatacq(lk->stat, lk->tacq - t0, w);
+#endif
   release(&lk->lk);
 }
 
@@ -35,9 +80,14 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+#ifdef LOCKSTAT
+  lockstathold(lk->stat, rdtsc() - lk->tacq);
+#endif
   lk->locked = 0;
   lk->pid = 0;
-  wakeup(lk);
+  lk->owner = 0;
+  if(lk->nwait)
+    wakeupone(lk);  // the others stay asleep until it releases
   release(&lk->lk);
 }
 
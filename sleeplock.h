@@ -2,9 +2,15 @@
 struct sleeplock {
   uint locked;       // Is the lock held?
   struct spinlock lk; // spinlock protecting this sleep lock
+  struct proc *owner; // Process holding lock
+  int nwait;         // Processes sleeping on the lock
   
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+#ifdef LOCKSTAT
+  struct lockclass *stat;  // Statistics for locks with this name
+  uint tacq;         // TSC when acquired
+#endif
 };
 
@@ -8,13 +8,18 @@
 #include "mmu.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "lockstat.h"
 
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+#ifdef LOCKSTAT
+  lk->stat = lockclass(name, 0);
+#endif
 }
 
 // Acquire the lock.
@@ -24,13 +29,29 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint t, n;
+#ifdef LOCKSTAT
+  uint t0;
+  int w;
+#endif
+
   pushcli(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // The xchg is atomic.
-  while(xchg(&lk->locked, 1) != 0)
-    ;
+  // Take a ticket; the xadd is atomic. Then wait for it
+  // to come up, only reading the lock meanwhile, and
+  // backing off longer the further back in line we are.
+  t = xadd(&lk->next, 1);
+#ifdef LOCKSTAT
+  t0 = rdtsc();
+  w = t != *(volatile uint*)&lk->owner;
+#endif
+  while((n = t - *(volatile uint*)&lk->owner) != 0){
+    n *= 32;
+    while(n-- > 0)
+      pause();
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -39,7 +60,13 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for debugging.
   lk->cpu = mycpu();
+#ifdef DEBUG
   getcallerpcs(&lk, lk->pcs);
+#endif
+#ifdef LOCKSTAT
+  lk->tacq = rdtsc();
+  lockstatacq(lk->stat, lk->tacq - t0, w);
+#endif
 }
 
 // Release the lock.
@@ -49,7 +76,12 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+#ifdef DEBUG
   lk->pcs[0] = 0;
+#endif
+#ifdef LOCKSTAT
+  lockstathold(lk->stat, rdtsc() - lk->tacq);
+#endif
   lk->cpu = 0;
 
   // Tell the C compiler and the processor to not move loads or stores
@@ -59,10 +91,10 @@ release(struct spinlock *lk)
   // stores; __sync_synchronize() tells them both not to.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code can't use a C assignment, since it might
-  // not be atomic. A real OS would use C atomics here.
-  asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  // Release the lock by serving the next ticket. Only the
+  // holder writes owner, so this needs no lock prefix, but it
+  // must be a single store. A real OS would use C atomics here.
+  asm volatile("incl %0" : "+m" (lk->owner) : );
 
   popcli();
 }
@@ -91,7 +123,7 @@ holding(struct spinlock *lock)
 {
   int r;
   pushcli();
-  r = lock->locked && lock->cpu == mycpu();
+  r = lock->owner != lock->next && lock->cpu == mycpu();
   popcli();
   return r;
 }
@@ -124,3 +156,141 @@ popcli(void)
     sti();
 }
 
+//PAGEBREAK!
+// Lock statistics. Locks with the same name share one
+// class, so e.g. all the buffer locks count together.
+// Each CPU counts into its own slot of a class, with
+// interrupts off, so counting takes no lock.
+
+#ifdef LOCKSTAT
+
+struct lscpu {
+  uint nacq;
+  uint ncont;
+  unsigned long long wait;
+  unsigned long long hold;
+  uint maxhold;
+};
+
+struct lockclass {
+  char name[LSNAME];
+  int sleep;
+  struct lscpu cpu[NCPU];
+};
+
+static struct lockclass classes[NLOCKCLASS];
+static int nclass;
+static uint classlock;  // guards adding a class; a spinlock would
+                        // recurse into lockclass()
+
+// Return the class for locks called name, adding it
+// if it is new. Returns 0 if the table is full.
+struct lockclass*
+lockclass(char *name, int sleep)
+{
+  struct lockclass *c;
+  int eflags;
+
+  // Interrupts off, so that an interrupted holder can't be
+  // spun on by a lock holder on the same CPU. Not pushcli():
+  // kinit1() gets here before mpinit() has found the CPUs.
+  eflags = readeflags();
+  cli();
+  while(xchg(&classlock, 1) != 0)
+    pause();
+  for(c = classes; c < &classes[nclass]; c++)
+    if(c->sleep == sleep && strncmp(c->name, name, LSNAME) == 0)
+      goto out;
+  c = 0;
+  if(nclass < NLOCKCLASS){
+    c = &classes[nclass];
+    safestrcpy(c->name, name, LSNAME);
+    c->sleep = sleep;
+    __sync_synchronize();  // lockstatread() may look without classlock
+    nclass++;
+  }
+out:
+  xchg(&classlock, 0);
+  if(eflags & FL_IF)
+    sti();
+  return c;
+}
+
+// Count an acquisition of a lock in class c that took wait
+// cycles. Called with interrupts off.
+void
+lockstatacq(struct lockclass *c, uint wait, int contended)
+{
+  struct lscpu *s;
+
+  if(c == 0)
+    return;
+  s = &c->cpu[mycpu() - cpus];
+  s->nacq++;
+  if(contended)
+    s->ncont++;
+  s->wait += wait;
+}
+
+// Count a release of a lock in class c held for hold cycles.
+// Called with interrupts off.
+void
+lockstathold(struct lockclass *c, uint hold)
+{
+  struct lscpu *s;
+
+  if(c == 0)
+    return;
+  s = &c->cpu[mycpu() - cpus];
+  s->hold += hold;
+  if(hold > s->maxhold)
+    s->maxhold = hold;
+}
+
+// Copy the statistics of up to n classes to ls, then zero
+// them all if reset is set. Other CPUs may be counting
+// meanwhile, so a reset can lose a count or two.
+// Returns the number of classes copied.
+int
+lockstatread(struct lockstat *ls, int n, int reset)
+{
+  struct lockclass *c;
+  struct lscpu *s;
+  unsigned long long wait, hold;
+  int i, m;
+
+  m = nclass;
+  if(n > m)
+    n = m;
+  for(i = 0; i < n; i++, ls++){
+    c = &classes[i];
+    memset(ls, 0, sizeof(*ls));
+    safestrcpy(ls->name, c->name, LSNAME);
+    ls->sleep = c->sleep;
+    wait = hold = 0;
+    for(s = c->cpu; s < &c->cpu[NCPU]; s++){
+      ls->nacq += s->nacq;
+      ls->ncont += s->ncont;
+      wait += s->wait;
+      hold += s->hold;
+      if(s->maxhold > ls->maxhold)
+        ls->maxhold = s->maxhold;
+    }
+    ls->kwait = wait >> 10;
+    ls->khold = hold >> 10;
+  }
+  if(reset)
+    for(i = 0; i < m; i++)
+      memset(classes[i].cpu, 0, sizeof(classes[i].cpu));
+  return n;
+}
+
+#else
+
+int
+lockstatread(struct lockstat *ls, int n, int reset)
+{
+  return -1;
+}
+
+#endif
@@ -1,11 +1,20 @@
-// Mutual exclusion lock.
+// Mutual exclusion lock: a ticket lock, so CPUs get
+// the lock in the order they asked for it.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;         // Next ticket to hand out
+  uint owner;        // Ticket now holding the lock;
+                     // the lock is free if owner == next.
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+#ifdef DEBUG
   uint pcs[10];      // The call stack (an array of program counters)
                      // that locked the lock.
+#endif
+#ifdef LOCKSTAT
+  struct lockclass *stat;  // Statistics for locks with this name
+  uint tacq;         // TSC when acquired
+#endif
 };
 
@@ -0,0 +1,58 @@
+// System call latency: time N getpid() calls through the
+// usys.S stub, which uses SYSENTER unless built with
+// SYSCALL=INT, and N more through int $T_SYSCALL.
+// Usage: sysbench [N]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "syscall.h"
+#include "traps.h"
+
+static int
+intgetpid(void)
+{
+  int pid;
+
+  // The kernel finds no arguments on the stack for getpid,
+  // so int can be issued here directly.
+  asm volatile("int %1" : "=a" (pid) : "i" (T_SYSCALL), "a" (SYS_getpid) : "memory");
+  return pid;
+}
+
+// Print the time taken by n calls, t ticks, as ns per call
+// assuming the usual 100 ticks per second.
+static void
+report(char *name, int n, int t)
+{
+  printf(1, "%s: %d calls in %d ticks", name, n, t);
+  if(n >= 1000)
+    printf(1, ", about %d ns each", t * 10000 / (n / 1000));
+  printf(1, "\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, t, pid;
+
+  n = 1000000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  pid = getpid();
+  if(intgetpid() != pid){
+    printf(2, "sysbench: getpid mismatch\n");
+    exit();
+  }
+
+  t = uptime();
+  for(i = 0; i < n; i++)
+    getpid();
+  report("stub", n, uptime() - t);
+
+  t = uptime();
+  for(i = 0; i < n; i++)
+    intgetpid();
+  report("int", n, uptime() - t);
+  exit();
+}
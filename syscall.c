@@ -6,6 +6,7 @@
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
+#include "trace.h"
 
 // User code makes a system call with INT T_SYSCALL.
 // System call number in %eax.
@@ -25,6 +26,19 @@ fetchint(uint addr, int *ip)
   return 0;
 }
 
+// Check that the size bytes at addr lie within
+// user memory, and set *pp to point to them.
+int
+fetchptr(uint addr, int size, char **pp)
+{
+  struct proc *curproc = myproc();
+
+  if(size < 0 || addr >= curproc->sz || addr+size > curproc->sz)
+    return -1;
+  *pp = (char*)addr;
+  return 0;
+}
+
 // Fetch the nul-terminated string at addr from the current process.
 // Doesn't actually copy the string - just sets *pp to point at it.
 // Returns length of string, not including nul.
@@ -59,14 +73,10 @@ int
 argptr(int n, char **pp, int size)
 {
   int i;
-  struct proc *curproc = myproc();
- 
+
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
-    return -1;
-  *pp = (char*)i;
-  return 0;
+  return fetchptr(i, size, pp);
 }
 
 // Fetch the nth word-sized system call argument as a string pointer.
@@ -105,7 +115,26 @@ extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_waitx(void);
 extern int sys_set_priority(void);
-extern int sys_my_ps(void);
+extern int sys_getprocs(void);
+extern int sys_fsync(void);
+extern int sys_pread(void);
+extern int sys_pwrite(void);
+extern int sys_readv(void);
+extern int sys_writev(void);
+extern int sys_splice(void);
+extern int sys_fcntl(void);
+extern int sys_poll(void);
+extern int sys_epoll_create(void);
+extern int sys_epoll_ctl(void);
+extern int sys_epoll_wait(void);
+extern int sys_ioring_setup(void);
+extern int sys_ioring_enter(void);
+extern int sys_lockstat(void);
+extern int sys_profile(void);
+extern int sys_profread(void);
+extern int sys_traceread(void);
+extern int sys_getrusage(void);
+extern int sys_wait4(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -131,7 +160,26 @@ static int (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_waitx]   sys_waitx,
 [SYS_set_priority] sys_set_priority,
-[SYS_my_ps] sys_my_ps,
+[SYS_getprocs] sys_getprocs,
+[SYS_fsync] sys_fsync,
+[SYS_pread] sys_pread,
+[SYS_pwrite] sys_pwrite,
+[SYS_readv] sys_readv,
+[SYS_writev] sys_writev,
+[SYS_splice] sys_splice,
+[SYS_fcntl] sys_fcntl,
+[SYS_poll] sys_poll,
+[SYS_epoll_create] sys_epoll_create,
+[SYS_epoll_ctl] sys_epoll_ctl,
+[SYS_epoll_wait] sys_epoll_wait,
+[SYS_ioring_setup] sys_ioring_setup,
+[SYS_ioring_enter] sys_ioring_enter,
+[SYS_lockstat] sys_lockstat,
+[SYS_profile] sys_profile,
+[SYS_profread] sys_profread,
+[SYS_traceread] sys_traceread,
+[SYS_getrusage] sys_getrusage,
+[SYS_wait4] sys_wait4,
 };
 
 void
@@ -142,7 +190,9 @@ syscall(void)
 
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    TRACE(TR_SYSCALL, num, 0);
     curproc->tf->eax = syscalls[num]();
+    TRACE(TR_SYSRET, num, curproc->tf->eax);
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
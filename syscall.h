@@ -22,4 +22,23 @@
 #define SYS_close           21
 #define SYS_waitx           22
 #define SYS_set_priority    23
-#define SYS_my_ps           24
\ No newline at end of file
+#define SYS_getprocs        24
+#define SYS_fsync           25
+#define SYS_pread           26
+#define SYS_pwrite          27
+#define SYS_readv           28
+#define SYS_writev          29
+#define SYS_splice          30
+#define SYS_fcntl           31
+#define SYS_poll            32
+#define SYS_epoll_create    33
+#define SYS_epoll_ctl       34
+#define SYS_epoll_wait      35
+#define SYS_ioring_setup    36
+#define SYS_ioring_enter    37
+#define SYS_lockstat        38
+#define SYS_profile         39
+#define SYS_profread        40
+#define SYS_traceread       41
+#define SYS_getrusage       42
+#define SYS_wait4           43
\ No newline at end of file
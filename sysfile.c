@@ -15,6 +15,9 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "uio.h"
+#include "poll.h"
+#include "ioring.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -52,6 +55,27 @@ fdalloc(struct file *f)
   return -1;
 }
 
+// Close fd, which must be open.
+static int
+fdclose(int fd)
+{
+  struct file *f = myproc()->ofile[fd];
+
+  myproc()->ofile[fd] = 0;
+  fileclose(f);
+  return 0;
+}
+
+// Make everything written so far durable.
+static int
+fdfsync(struct file *f)
+{
+  if(f->type != FD_INODE)
+    return -1;
+  log_force();
+  return 0;
+}
+
 int
 sys_dup(void)
 {
@@ -90,6 +114,213 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+int
+sys_pread(void)
+{
+  struct file *f;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+int
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
+// Fetch the iovec array that is argument 1, with its length
+// in argument 2, into iov, and check each buffer it names.
+static int
+argiov(struct iovec *iov, int *cnt)
+{
+  struct proc *curproc = myproc();
+  char *p;
+  uint base;
+  int i;
+
+  if(argint(2, cnt) < 0 || *cnt < 0 || *cnt > IOV_MAX ||
+     argptr(1, &p, *cnt * sizeof(*iov)) < 0)
+    return -1;
+  memmove(iov, p, *cnt * sizeof(*iov));
+  for(i = 0; i < *cnt; i++){
+    base = (uint)iov[i].iov_base;
+    if(iov[i].iov_len < 0 || base >= curproc->sz ||
+       base + iov[i].iov_len > curproc->sz)
+      return -1;
+  }
+  return 0;
+}
+
+int
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argiov(iov, &cnt) < 0)
+    return -1;
+  return filereadv(f, iov, cnt);
+}
+
+int
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argiov(iov, &cnt) < 0)
+    return -1;
+  return filewritev(f, iov, cnt);
+}
+
+// Move up to n bytes from fd in to fd out without
+// copying them through user memory.
+int
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n;
+
+  if(argfd(0, 0, &in) < 0 || argfd(1, 0, &out) < 0 || argint(2, &n) < 0)
+    return -1;
+  return filesplice(in, out, n);
+}
+
+int
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &cmd) < 0 || argint(2, &arg) < 0)
+    return -1;
+  switch(cmd){
+  case F_GETFL:
+    return (f->writable ? (f->readable ? O_RDWR : O_WRONLY) : O_RDONLY) |
+           (f->nonblock ? O_NONBLOCK : 0);
+  case F_SETFL:
+    f->nonblock = (arg & O_NONBLOCK) != 0;
+    return 0;
+  case F_GETPIPE_SZ:
+    if(f->type != FD_PIPE)
+      return -1;
+    return pipesize(f->pipe, 0);
+  case F_SETPIPE_SZ:
+    if(f->type != FD_PIPE || arg <= 0)
+      return -1;
+    return pipesize(f->pipe, arg);
+  }
+  return -1;
+}
+
+// Wait for any of an array of fds to be ready.
+int
+sys_poll(void)
+{
+  struct pollfd *fds;
+  int n, timeout;
+
+  if(argint(1, &n) < 0 || argint(2, &timeout) < 0)
+    return -1;
+  if(n < 0 || n > POLLMAX)
+    return -1;
+  if(argptr(0, (void*)&fds, n*sizeof(*fds)) < 0)
+    return -1;
+  return poll(fds, n, timeout);
+}
+
+int
+sys_epoll_create(void)
+{
+  struct file *f;
+  int fd;
+
+  if((f = filealloc()) == 0)
+    return -1;
+  if((f->ep = epollcreate()) == 0){
+    fileclose(f);
+    return -1;
+  }
+  f->type = FD_EPOLL;
+  f->readable = 0;
+  f->writable = 0;
+  f->nonblock = 0;
+  if((fd = fdalloc(f)) < 0){
+    fileclose(f);
+    return -1;
+  }
+  return fd;
+}
+
+// Get the epoll of epoll fd n.
+static int
+argepoll(int n, struct epoll **pep)
+{
+  struct file *f;
+
+  if(argfd(n, 0, &f) < 0 || f->type != FD_EPOLL)
+    return -1;
+  *pep = f->ep;
+  return 0;
+}
+
+int
+sys_epoll_ctl(void)
+{
+  struct epoll *ep;
+  struct epoll_event *ev;
+  int op, fd;
+
+  if(argepoll(0, &ep) < 0 || argint(1, &op) < 0 || argint(2, &fd) < 0)
+    return -1;
+  ev = 0;
+  if(op != EPOLL_CTL_DEL && argptr(3, (void*)&ev, sizeof(*ev)) < 0)
+    return -1;
+  return epollctl(ep, op, fd, ev);
+}
+
+int
+sys_epoll_wait(void)
+{
+  struct epoll *ep;
+  struct epoll_event *evs;
+  int n, timeout;
+
+  if(argepoll(0, &ep) < 0 || argint(2, &n) < 0 || argint(3, &timeout) < 0)
+    return -1;
+  if(n <= 0)
+    return -1;
+  if(n > EPOLLMAX)
+    n = EPOLLMAX;  // no more can be ready, and n*sizeof must not wrap
+  if(argptr(1, (void*)&evs, n*sizeof(*evs)) < 0)
+    return -1;
+  return epollwait(ep, evs, n, timeout);
+}
+
+int
+sys_fsync(void)
+{
+  struct file *f;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  return fdfsync(f);
+}
+
 int
 sys_close(void)
 {
@@ -98,9 +329,7 @@ sys_close(void)
 
   if(argfd(0, &fd, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
-  fileclose(f);
-  return 0;
+  return fdclose(fd);
 }
 
 int
@@ -171,10 +400,10 @@ isdirempty(struct inode *dp)
   int off;
   struct dirent de;
 
-  for(off=2*sizeof(de); off<dp->size; off+=sizeof(de)){
+  for(off=0; off<dp->size; off+=sizeof(de)){
     if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
       panic("isdirempty: readi");
-    if(de.inum != 0)
+    if(de.inum != 0 && namecmp(de.name, ".") != 0 && namecmp(de.name, "..") != 0)
       return 0;
   }
   return 1;
@@ -185,7 +414,6 @@ int
 sys_unlink(void)
 {
   struct inode *ip, *dp;
-  struct dirent de;
   char name[DIRSIZ], *path;
   uint off;
 
@@ -215,9 +443,7 @@ sys_unlink(void)
     goto bad;
   }
 
-  memset(&de, 0, sizeof(de));
-  if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-    panic("unlink: writei");
+  dirunlink(dp, name, off);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -282,17 +508,14 @@ create(char *path, short type, short major, short minor)
   return ip;
 }
 
-int
-sys_open(void)
+// Open path with mode omode and return its new fd.
+static int
+fdopen(char *path, int omode)
 {
-  char *path;
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
 
-  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
-    return -1;
-
   begin_op();
 
   if(omode & O_CREATE){
@@ -329,9 +552,21 @@ sys_open(void)
   f->off = 0;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->nonblock = (omode & O_NONBLOCK) != 0;
   return fd;
 }
 
+int
+sys_open(void)
+{
+  char *path;
+  int omode;
+
+  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return fdopen(path, omode);
+}
+
 int
 sys_mkdir(void)
 {
@@ -442,3 +677,84 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+// Register the process's submission and completion rings.
+int
+sys_ioring_setup(void)
+{
+  char *r;
+
+  if(argptr(0, &r, sizeof(struct io_ring)) < 0)
+    return -1;
+  myproc()->ring = (struct io_ring*)r;
+  return 0;
+}
+
+// Run one request from a ring, returning what
+// the matching system call would.
+static int
+iorun(struct io_sqe *sqe)
+{
+  struct file *f;
+  char *p;
+
+  if(sqe->op == IORING_OP_NOP)
+    return 0;
+  if(sqe->op == IORING_OP_OPEN){
+    if(fetchstr((uint)sqe->addr, &p) < 0)
+      return -1;
+    return fdopen(p, sqe->len);
+  }
+  if(sqe->fd < 0 || sqe->fd >= NOFILE || (f = myproc()->ofile[sqe->fd]) == 0)
+    return -1;
+  switch(sqe->op){
+  case IORING_OP_READ:
+  case IORING_OP_WRITE:
+    if(fetchptr((uint)sqe->addr, sqe->len, &p) < 0)
+      return -1;
+    if(sqe->op == IORING_OP_READ)
+      return sqe->off < 0 ? fileread(f, p, sqe->len) : filepread(f, p, sqe->len, sqe->off);
+    return sqe->off < 0 ? filewrite(f, p, sqe->len) : filepwrite(f, p, sqe->len, sqe->off);
+  case IORING_OP_CLOSE:
+    return fdclose(sqe->fd);
+  case IORING_OP_FSYNC:
+    return fdfsync(f);
+  }
+  return -1;
+}
+
+// Run up to n submitted requests, or all of them if n is 0,
+// stopping early if the completion ring fills up.
+// Returns the number run.
+// Requests run here in the caller rather than on a kthread:
+// they name the caller's fds and user addresses, and a kthread
+// has neither an ofile table nor the caller's page table.
+int
+sys_ioring_enter(void)
+{
+  struct io_ring *r;
+  struct io_sqe sqe;
+  struct io_cqe *cqe;
+  char *p;
+  int n, done;
+
+  if(argint(0, &n) < 0 || n < 0 || (r = myproc()->ring) == 0)
+    return -1;
+  // The process may have shrunk since ioring_setup().
+  if(fetchptr((uint)r, sizeof(*r), &p) < 0)
+    return -1;
+
+  for(done = 0; n == 0 || done < n; done++){
+    if(r->sqhead == r->sqtail || r->cqtail - r->cqhead >= IORING_CQSIZE)
+      break;
+    // Copy the request so the process can't change it under us.
+    sqe = r->sq[r->sqhead % IORING_SQSIZE];
+    r->sqhead++;
+    cqe = &r->cq[r->cqtail % IORING_CQSIZE];
+    cqe->data = sqe.data;
+    cqe->res = iorun(&sqe);
+    __sync_synchronize();
+    r->cqtail++;
+  }
+  return done;
+}
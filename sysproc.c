@@ -6,6 +6,11 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "lockstat.h"
+#include "profile.h"
+#include "trace.h"
+#include "procinfo.h"
+#include "rusage.h"
 
 int
 sys_fork(void)
@@ -116,8 +121,108 @@ sys_set_priority(void)
   return set_priority(new_priority, pid);
 }
 
+// Copy up to argument 1 processes into the array
+// in argument 0.
 int
-sys_my_ps(void)
+sys_getprocs(void)
 {
-  return my_ps();
-}
\ No newline at end of file
+  struct procinfo *pi;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NPROC)
+    n = NPROC;  // so n*sizeof cannot wrap
+  if(argptr(0, (void*)&pi, n*sizeof(*pi)) < 0)
+    return -1;
+  return getprocs(pi, n);
+}
+
+// Copy the lock statistics to the array in argument 0,
+// which has room for argument 1 entries, and reset them
+// if argument 2 is set. Fails unless built with LOCKSTAT.
+int
+sys_lockstat(void)
+{
+  struct lockstat *ls;
+  int n, reset;
+
+  if(argint(1, &n) < 0 || argint(2, &reset) < 0 || n < 0)
+    return -1;
+  if(n > NLOCKCLASS)
+    n = NLOCKCLASS;  // so n*sizeof cannot wrap
+  if(argptr(0, (void*)&ls, n*sizeof(*ls)) < 0)
+    return -1;
+  return lockstatread(ls, n, reset);
+}
+
+// Turn the sampling profiler on or off.
+int
+sys_profile(void)
+{
+  int on;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  return profile(on != 0);
+}
+
+// Move up to argument 1 profiler samples into
+// the array in argument 0.
+int
+sys_profread(void)
+{
+  struct profsample *s;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NCPU*PROFN)
+    n = NCPU*PROFN;  // so n*sizeof cannot wrap
+  if(argptr(0, (void*)&s, n*sizeof(*s)) < 0)
+    return -1;
+  return profread(s, n);
+}
+
+// Move up to argument 1 trace records into the array in
+// argument 0. Fails unless built with TRACE.
+int
+sys_traceread(void)
+{
+  struct tracerec *t;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NCPU*TRACEN)
+    n = NCPU*TRACEN;  // so n*sizeof cannot wrap
+  if(argptr(0, (void*)&t, n*sizeof(*t)) < 0)
+    return -1;
+  return traceread(t, n);
+}
+
+int
+sys_getrusage(void)
+{
+  struct rusage *ru;
+  int who;
+
+  if(argint(0, &who) < 0 || argptr(1, (void*)&ru, sizeof(*ru)) < 0)
+    return -1;
+  return getrusage(who, ru);
+}
+
+// Wait for child argument 0, or any child if it is <= 0, and
+// store its resource usage in argument 1 unless that is 0.
+int
+sys_wait4(void)
+{
+  struct rusage *ru;
+  int pid;
+
+  if(argint(0, &pid) < 0 || argint(1, (int*)&ru) < 0)
+    return -1;
+  if(ru && argptr(1, (void*)&ru, sizeof(*ru)) < 0)
+    return -1;
+  return wait4(pid, ru);
+}
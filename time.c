@@ -2,15 +2,24 @@
 #include "stat.h"
 #include "user.h"
 #include "fs.h"
+#include "rusage.h"
+
+// Print us microseconds as seconds.
+void
+printsec(char *what, uint us)
+{
+    uint ms = us / 1000 % 1000;
+
+    printf(1, "%s%d.%s%s%ds\n", what, us / 1000000,
+           ms < 100 ? "0" : "", ms < 10 ? "0" : "", ms);
+}
 
 int main(int argc, char** argv)
 {
-    // if(argc<=1)
-    // {
-    //     printf(2, "time: Insufficient number of arguments\n");
-    //     exit();
-    // }
+    struct rusage ru;
+    uint start;
 
+    start = vclock();
     int pid = fork();
     if(pid < 0)
     {
@@ -39,17 +48,22 @@ int main(int argc, char** argv)
     }
     else if(pid > 0)
     {
-        int wtime, rtime;
-        int id = waitx(&wtime, &rtime);
-        if(argc == 1)
+        // The usage covers the command and every process
+        // it waited for, so a whole pipeline run by sh.
+        if(wait4(pid, &ru) < 0)
         {
-            printf(1, "Details of default time function\nWaiting time: %d\nRunning time: %d\n", wtime, rtime);
-        }
-        else
-        {
-            printf(1, "Details of time for %s\nProcess id: %d\nWaiting time: %d\nRunning time: %d\n", argv[1], id, wtime, rtime);
+            printf(2, "time: wait4 failed\n");
+            exit();
         }
-        
+        printf(1, "Details of time for %s\nProcess id: %d\n",
+               argc == 1 ? "default time function" : argv[1], pid);
+        printsec("real\t", vclock() - start);
+        printsec("user\t", ru.utime);
+        printsec("sys\t", ru.stime);
+        printf(1, "switches\t%d voluntary, %d involuntary\n", ru.nvcsw, ru.nivcsw);
+        printf(1, "faults\t%d\n", ru.nfault);
+        printf(1, "blocks\t%d read, %d written\n", ru.inblock, ru.oublock);
+        printf(1, "maxrss\t%d KB\n", ru.maxrss);
         exit();
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,113 @@
+//
+// Kernel event tracing. Kernels built with TRACE=TRUE record
+// the TRACE() tracepoints in defs.h; other kernels compile
+// them away. Each CPU writes its own ring, with interrupts
+// off and without a lock, overwriting its oldest records.
+// traceread() copies records out under trace.lock and
+// throws away any that were overwritten while it copied.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "trace.h"
+
+#ifdef TRACING
+
+struct tracering {
+  uint head;   // records written
+  uint tail;   // records read
+  struct tracerec rec[TRACEN];
+};
+
+static struct {
+  struct spinlock lock;
+  struct tracering ring[NCPU];
+} traces;
+
+void
+traceinit(void)
+{
+  initlock(&traces.lock, "trace");
+}
+
+void
+trace(int type, uint a, uint b)
+{
+  struct tracering *r;
+  struct tracerec *t;
+  struct proc *p;
+
+  pushcli();
+  r = &traces.ring[cpuid()];
+  t = &r->rec[r->head % TRACEN];
+  asm volatile("rdtsc" : "=a" (t->tsc[0]), "=d" (t->tsc[1]));
+  t->type = type;
+  t->cpu = cpuid();
+  p = mycpu()->proc;
+  t->pid = p ? p->pid : 0;
+  t->a = a;
+  t->b = b;
+  __sync_synchronize();  // traceread() must see the record first
+  r->head++;
+  popcli();
+}
+
+// Move up to n records not read before into t, one CPU
+// after another, each CPU's oldest first.
+// Returns the number moved.
+int
+traceread(struct tracerec *t, int n)
+{
+  struct tracering *r;
+  uint h, i, first;
+  int m, m0;
+
+  m = 0;
+  acquire(&traces.lock);
+  for(r = traces.ring; r < &traces.ring[NCPU] && m < n; r++){
+    h = r->head;
+    __sync_synchronize();
+    first = r->tail;
+    if(h - first > TRACEN)
+      first = h - TRACEN;
+    m0 = m;
+    for(i = first; i != h && m < n; i++)
+      t[m++] = r->rec[i % TRACEN];
+    r->tail = i;
+
+    // The CPU may have overwritten records meanwhile: the one
+    // it is writing is at head, in the slot of head-TRACEN.
+    __sync_synchronize();
+    h = r->head;
+    if(h - first >= TRACEN){
+      i = h - first - TRACEN + 1;  // records lost at the front
+      if(i > m - m0)
+        i = m - m0;
+      memmove(t + m0, t + m0 + i, (m - m0 - i) * sizeof(*t));
+      m -= i;
+    }
+  }
+  release(&traces.lock);
+  return m;
+}
+
+#else
+
+void
+traceinit(void)
+{
+}
+
+int
+traceread(struct tracerec *t, int n)
+{
+  return -1;
+}
+
+#endif
@@ -0,0 +1,28 @@
+// Kernel trace records, from the traceread system call.
+// Kernels built with TRACE=TRUE record them, see trace.c.
+
+#define TRACEN 256  // records kept per CPU
+
+// Record types, and what a and b hold.
+#define TR_SCHED     1   // scheduler picked pid a
+#define TR_PROMOTE   2   // MLFQ moved pid a up to queue b
+#define TR_DEMOTE    3   // MLFQ moved pid a down to queue b
+#define TR_PRIORITY  4   // set_priority() gave pid a priority b
+#define TR_SLEEP     5   // process sleeps on channel a
+#define TR_WAKEUP    6   // pid a woken from channel b
+#define TR_SYSCALL   7   // system call a entered
+#define TR_SYSRET    8   // system call a returned b
+#define TR_PGFAULT   9   // page fault at address a, eip b
+#define TR_BHIT      10  // buffer cache hit on block a of dev b
+#define TR_BMISS     11  // buffer cache miss on block a of dev b
+#define TR_IDESTART  12  // disk started block a, writing if b
+#define TR_IDEDONE   13  // disk finished block a
+
+struct tracerec {
+  uint tsc[2];    // TSC when recorded, low word first
+  ushort type;    // TR_*
+  ushort cpu;     // CPU that recorded it
+  int pid;        // process running on that CPU, or 0
+  uint a;
+  uint b;
+};
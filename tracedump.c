@@ -0,0 +1,125 @@
+// Print the kernel trace records of a kernel built with
+// TRACE=TRUE, oldest first, with times in microseconds
+// since the first one.
+// Usage: tracedump            print the records not yet read
+//        tracedump cmd args   run cmd, then print its records
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "vdso.h"
+#include "trace.h"
+
+#define NREC 4096
+
+struct tracerec rec[NREC];
+
+char *names[] = {
+[TR_SCHED]     "sched",
+[TR_PROMOTE]   "promote",
+[TR_DEMOTE]    "demote",
+[TR_PRIORITY]  "priority",
+[TR_SLEEP]     "sleep",
+[TR_WAKEUP]    "wakeup",
+[TR_SYSCALL]   "syscall",
+[TR_SYSRET]    "sysret",
+[TR_PGFAULT]   "pgfault",
+[TR_BHIT]      "bhit",
+[TR_BMISS]     "bmiss",
+[TR_IDESTART]  "idestart",
+[TR_IDEDONE]   "idedone",
+};
+
+unsigned long long
+tsc(struct tracerec *t)
+{
+  return ((unsigned long long)t->tsc[1] << 32) | t->tsc[0];
+}
+
+// n / d, without the 64-bit division helpers
+// that user programs are not linked with.
+uint
+div64(unsigned long long n, uint d)
+{
+  unsigned long long q, r;
+  int i;
+
+  q = r = 0;
+  for(i = 63; i >= 0; i--){
+    r = (r << 1) | ((n >> i) & 1);
+    if(r >= d){
+      r -= d;
+      q |= 1ULL << i;
+    }
+  }
+  return q;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct vdata *vd = (struct vdata*)VDATA;
+  struct tracerec t;
+  unsigned long long t0;
+  uint cpus;
+  int i, j, n, m;
+  char *name;
+
+  if((n = traceread(rec, NREC)) < 0){
+    printf(2, "tracedump: kernel built without TRACE\n");
+    exit();
+  }
+  if(argc > 1){
+    // Throw away what came before the command.
+    while(n == NREC)
+      n = traceread(rec, NREC);
+    if((i = fork()) < 0){
+      printf(2, "tracedump: fork failed\n");
+      exit();
+    }
+    if(i == 0){
+      exec(argv[1], argv + 1);
+      printf(2, "tracedump: exec %s failed\n", argv[1]);
+      exit();
+    }
+    wait();
+    n = traceread(rec, NREC);
+  } else {
+    while(n < NREC && (m = traceread(rec + n, NREC - n)) > 0)
+      n += m;
+  }
+
+  for(i = 1; i < n; i++){
+    t = rec[i];
+    for(j = i; j > 0 && tsc(&rec[j-1]) > tsc(&t); j--)
+      rec[j] = rec[j-1];
+    rec[j] = t;
+  }
+
+  // TSC cycles per microsecond, from the clock page.
+  cpus = vd->tscpertick / (1000000 / vd->hz);
+  if(cpus == 0)
+    cpus = 1;
+  t0 = n > 0 ? tsc(&rec[0]) : 0;
+  for(i = 0; i < n; i++){
+    name = "?";
+    if(rec[i].type < sizeof(names)/sizeof(names[0]) && names[rec[i].type])
+      name = names[rec[i].type];
+    printf(1, "%d cpu%d pid %d %s", div64(tsc(&rec[i]) - t0, cpus),
+      rec[i].cpu, rec[i].pid, name);
+    switch(rec[i].type){
+    case TR_SLEEP:
+      printf(1, " 0x%x\n", rec[i].a);
+      break;
+    case TR_WAKEUP:
+      printf(1, " %d 0x%x\n", rec[i].a, rec[i].b);
+      break;
+    case TR_PGFAULT:
+      printf(1, " 0x%x 0x%x\n", rec[i].a, rec[i].b);
+      break;
+    default:
+      printf(1, " %d %d\n", rec[i].a, rec[i].b);
+    }
+  }
+  exit();
+}
@@ -7,6 +7,7 @@
 #include "x86.h"
 #include "traps.h"
 #include "spinlock.h"
+#include "trace.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
@@ -36,6 +37,9 @@ idtinit(void)
 void
 trap(struct trapframe *tf)
 {
+  if((tf->cs&3) == DPL_USER)
+    rucharge(1);
+
   if(tf->trapno == T_SYSCALL){
     if(myproc()->killed)
       exit();
@@ -43,6 +47,7 @@ trap(struct trapframe *tf)
     syscall();
     if(myproc()->killed)
       exit();
+    rucharge(0);
     return;
   }
 
@@ -53,8 +58,12 @@ trap(struct trapframe *tf)
       ticks++;
       inc_time();
       wakeup(&ticks);
+      vdsotick();
       release(&tickslock);
+      polltick();
+      logtick();
     }
+    proftick(tf);
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -81,6 +90,11 @@ trap(struct trapframe *tf)
 
   //PAGEBREAK: 13
   default:
+    if(tf->trapno == T_PGFLT){
+      TRACE(TR_PGFAULT, rcr2(), tf->eip);
+      if(myproc())
+        myproc()->ru.nfault++;
+    }
     if(myproc() == 0 || (tf->cs&3) == 0){
       // In kernel, it must be our mistake.
       cprintf("unexpected trap %d from cpu %d eip %x (cr2=0x%x)\n",
@@ -128,4 +142,7 @@ trap(struct trapframe *tf)
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
+
+  if((tf->cs&3) == DPL_USER)
+    rucharge(0);
 }
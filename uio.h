@@ -0,0 +1,7 @@
+// Scatter/gather I/O buffers for readv() and writev().
+struct iovec {
+  void *iov_base;   // start of buffer
+  int iov_len;      // its length in bytes
+};
+
+#define IOV_MAX 16  // max buffers per readv() or writev()
@@ -3,6 +3,7 @@
 #include "fcntl.h"
 #include "user.h"
 #include "x86.h"
+#include "vdso.h"
 
 char*
 strcpy(char *s, const char *t)
@@ -104,3 +105,61 @@ memmove(void *vdst, const void *vsrc, int n)
     *dst++ = *src++;
   return vdst;
 }
+
+// Readers of the pages the kernel maps at VDATA and VPROC.
+// None of them enters the kernel.
+static volatile struct vdata *const vd = (struct vdata*)VDATA;
+static volatile struct vproc *const vp = (struct vproc*)VPROC;
+
+int
+vgetpid(void)
+{
+  return vp->pid;
+}
+
+int
+vgetppid(void)
+{
+  return vp->ppid;
+}
+
+// Same as uptime().
+uint
+vticks(void)
+{
+  return vd->ticks;
+}
+
+// Seconds since 1970-01-01 UTC.
+uint
+vtime(void)
+{
+  return vd->time;
+}
+
+// Microseconds since boot, from ticks and the TSC.
+// Wraps after about 71 minutes.
+uint
+vclock(void)
+{
+  uint seq, t, tsc, tpt, hz, us, upt, d;
+
+  do {
+    while((seq = vd->seq) & 1)
+      ;
+    t = vd->ticks;
+    tsc = vd->tsc;
+    tpt = vd->tscpertick;
+    hz = vd->hz;
+    d = rdtsc() - tsc;
+  } while(vd->seq != seq);
+
+  upt = 1000000 / hz;  // microseconds per tick
+  us = t * upt;
+  if(tpt >= upt){
+    d /= tpt / upt;
+    us += d < upt ? d : upt - 1;
+  }
+  return us;
+}
+
@@ -1,5 +1,14 @@
 struct stat;
+struct iovec;
+struct pollfd;
+struct epoll_event;
+struct io_ring;
+struct lockstat;
+struct procinfo;
+struct profsample;
+struct tracerec;
 struct rtcdate;
+struct rusage;
 
 // system calls
 int fork(void);
@@ -25,7 +34,26 @@ int sleep(int);
 int uptime(void);
 int waitx(int *, int *);
 int set_priority(int, int);
-int my_ps();
+int getprocs(struct procinfo*, int);
+int fsync(int);
+int pread(int, void*, int, int);
+int pwrite(int, const void*, int, int);
+int readv(int, struct iovec*, int);
+int writev(int, struct iovec*, int);
+int splice(int, int, int);
+int fcntl(int, int, int);
+int poll(struct pollfd*, int, int);
+int epoll_create(void);
+int epoll_ctl(int, int, int, struct epoll_event*);
+int epoll_wait(int, struct epoll_event*, int, int);
+int ioring_setup(struct io_ring*);
+int ioring_enter(int);
+int lockstat(struct lockstat*, int, int);
+int profile(int);
+int profread(struct profsample*, int);
+int traceread(struct tracerec*, int);
+int getrusage(int, struct rusage*);
+int wait4(int, struct rusage*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -40,3 +68,8 @@ void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+int vgetpid(void);
+int vgetppid(void);
+uint vticks(void);
+uint vtime(void);
+uint vclock(void);
@@ -7,8 +7,16 @@
 #include "syscall.h"
 #include "traps.h"
 #include "memlayout.h"
+#include "uio.h"
+#include "poll.h"
+#include "ioring.h"
+#include "rusage.h"
 
 char buf[8192];
+
+// 512-byte writes in the big files test: a file of MAXFILE
+// blocks with 512-byte blocks, 8 MB with bigger ones.
+#define NBIG (BSIZE == 512 ? MAXFILE : 16*1024)
 char name[3];
 char *echoargv[] = { "echo", "ALL", "TESTS", "PASSED", 0 };
 int stdout = 1;
@@ -197,7 +205,7 @@ writetest1(void)
     exit();
   }
 
-  for(i = 0; i < MAXFILE; i++){
+  for(i = 0; i < NBIG; i++){
     ((int*)buf)[0] = i;
     if(write(fd, buf, 512) != 512){
       printf(stdout, "error: write big file failed\n", i);
@@ -217,7 +225,7 @@ writetest1(void)
   for(;;){
     i = read(fd, buf, 512);
     if(i == 0){
-      if(n == MAXFILE - 1){
+      if(n == NBIG - 1){
         printf(stdout, "read only %d blocks from big", n);
         exit();
       }
@@ -241,6 +249,175 @@ writetest1(void)
   printf(stdout, "big files ok\n");
 }
 
+// positioned and scatter/gather I/O
+void
+piotest(void)
+{
+  int fd;
+  char a[10], b[10];
+  struct iovec iov[2];
+
+  printf(stdout, "pread/pwrite test\n");
+
+  fd = open("piofile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(stdout, "error: creat piofile failed!\n");
+    exit();
+  }
+  memset(a, 'a', sizeof(a));
+  memset(b, 'b', sizeof(b));
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof(a);
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof(b);
+  if(writev(fd, iov, 2) != 20){
+    printf(stdout, "error: writev failed\n");
+    exit();
+  }
+  if(pwrite(fd, "xy", 2, 9) != 2){
+    printf(stdout, "error: pwrite failed\n");
+    exit();
+  }
+  if(pwrite(fd, "z", 1, 21) >= 0){
+    printf(stdout, "error: pwrite past end of file succeeded\n");
+    exit();
+  }
+  // pwrite must not have moved the offset
+  if(write(fd, "c", 1) != 1){
+    printf(stdout, "error: write failed\n");
+    exit();
+  }
+  if(pread(fd, buf, 3, 8) != 3 || buf[0] != 'a' || buf[1] != 'x' || buf[2] != 'y'){
+    printf(stdout, "error: pread wrong data\n");
+    exit();
+  }
+  close(fd);
+
+  fd = open("piofile", O_RDONLY);
+  memset(a, 0, sizeof(a));
+  memset(b, 0, sizeof(b));
+  if(readv(fd, iov, 2) != 20 || a[0] != 'a' || a[9] != 'x' || b[0] != 'y' || b[9] != 'b'){
+    printf(stdout, "error: readv wrong data\n");
+    exit();
+  }
+  if(read(fd, buf, sizeof(buf)) != 1 || buf[0] != 'c'){
+    printf(stdout, "error: read after readv wrong data\n");
+    exit();
+  }
+  close(fd);
+  if(unlink("piofile") < 0){
+    printf(stdout, "unlink piofile failed\n");
+    exit();
+  }
+
+  printf(stdout, "pread/pwrite ok\n");
+}
+
+// fsync on a file and on a pipe
+void
+fsynctest(void)
+{
+  int fd, p[2];
+
+  printf(stdout, "fsync test\n");
+
+  fd = open("fsyncfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(stdout, "error: creat fsyncfile failed!\n");
+    exit();
+  }
+  if(write(fd, "x", 1) != 1 || fsync(fd) != 0){
+    printf(stdout, "error: fsync of a file failed\n");
+    exit();
+  }
+  close(fd);
+  if(pipe(p) < 0){
+    printf(stdout, "pipe() failed\n");
+    exit();
+  }
+  if(fsync(p[0]) != -1 || fsync(p[1]) != -1 || fsync(-1) != -1){
+    printf(stdout, "error: fsync of a pipe or bad fd succeeded\n");
+    exit();
+  }
+  close(p[0]);
+  close(p[1]);
+  if(unlink("fsyncfile") < 0){
+    printf(stdout, "unlink fsyncfile failed\n");
+    exit();
+  }
+
+  printf(stdout, "fsync ok\n");
+}
+
+// splice from a file into a pipe and back out to a file
+void
+splicetest(void)
+{
+  int in, out, p[2], i;
+
+  printf(stdout, "splice test\n");
+
+  for(i = 0; i < 1000; i++)
+    buf[i] = 'a' + i % 26;
+  in = open("splicein", O_CREATE|O_RDWR);
+  out = open("spliceout", O_CREATE|O_RDWR);
+  if(in < 0 || out < 0){
+    printf(stdout, "error: creat splice files failed!\n");
+    exit();
+  }
+  if(write(in, buf, 1000) != 1000){
+    printf(stdout, "error: write splicein failed\n");
+    exit();
+  }
+  close(in);
+  in = open("splicein", O_RDONLY);
+  if(pipe(p) < 0){
+    printf(stdout, "pipe() failed\n");
+    exit();
+  }
+  if(splice(in, p[1], 0) != 0){
+    printf(stdout, "error: splice of 0 bytes failed\n");
+    exit();
+  }
+  if(splice(in, p[1], 1000) != 1000 || splice(in, p[1], 10) != 0){
+    printf(stdout, "error: splice from file to pipe failed\n");
+    exit();
+  }
+  if(splice(p[0], out, 1000) != 1000){
+    printf(stdout, "error: splice from pipe to file failed\n");
+    exit();
+  }
+  if(splice(-1, p[1], 1) != -1 || splice(in, NOFILE - 1, 1) != -1 ||
+     splice(p[1], out, 1) != -1){
+    printf(stdout, "error: splice with a bad fd succeeded\n");
+    exit();
+  }
+  close(in);
+  close(out);
+  close(p[0]);
+  close(p[1]);
+
+  out = open("spliceout", O_RDONLY);
+  memset(buf, 0, 1000);
+  if(read(out, buf, sizeof(buf)) != 1000){
+    printf(stdout, "error: read spliceout failed\n");
+    exit();
+  }
+  for(i = 0; i < 1000; i++){
+    if(buf[i] != 'a' + i % 26){
+      printf(stdout, "error: splice wrong data\n");
+      exit();
+    }
+  }
+  close(out);
+  if(unlink("splicein") < 0 || unlink("spliceout") < 0){
+    printf(stdout, "unlink splice files failed\n");
+    exit();
+  }
+
+  printf(stdout, "splice ok\n");
+}
+
 void
 createtest(void)
 {
@@ -354,6 +531,356 @@ pipe1(void)
   printf(1, "pipe1 ok\n");
 }
 
+// O_NONBLOCK pipes and poll()
+void
+polltest(void)
+{
+  int a[2], b[2];
+  char c;
+  struct pollfd pfd[2];
+
+  printf(1, "poll test\n");
+  if(pipe(a) < 0 || pipe(b) < 0){
+    printf(1, "pipe() failed\n");
+    exit();
+  }
+  if(fcntl(a[0], F_SETFL, O_NONBLOCK) < 0 ||
+     (fcntl(a[0], F_GETFL, 0) & O_NONBLOCK) == 0){
+    printf(1, "poll: fcntl failed\n");
+    exit();
+  }
+  if(read(a[0], &c, 1) != -1){
+    printf(1, "poll: empty non-blocking read did not fail\n");
+    exit();
+  }
+  pfd[0].fd = a[0];
+  pfd[1].fd = b[0];
+  pfd[0].events = pfd[1].events = POLLIN;
+  if(poll(pfd, 2, 0) != 0 || poll(pfd, 2, 2) != 0){
+    printf(1, "poll: empty pipes ready\n");
+    exit();
+  }
+  write(b[1], "x", 1);
+  if(poll(pfd, 2, -1) != 1 || pfd[0].revents != 0 || pfd[1].revents != POLLIN){
+    printf(1, "poll: wrong ready set\n");
+    exit();
+  }
+  close(a[1]);
+  if(poll(pfd, 1, -1) != 1 || pfd[0].revents != POLLHUP || read(a[0], &c, 1) != 0){
+    printf(1, "poll: no hangup\n");
+    exit();
+  }
+  close(a[0]);
+  close(b[0]);
+  close(b[1]);
+  printf(1, "poll ok\n");
+}
+
+// epoll, level- and edge-triggered
+void
+epolltest(void)
+{
+  int ep, a[2], b[2];
+  char c;
+  struct epoll_event ev, out[4];
+
+  printf(1, "epoll test\n");
+  if((ep = epoll_create()) < 0 || pipe(a) < 0 || pipe(b) < 0){
+    printf(1, "epoll: setup failed\n");
+    exit();
+  }
+  ev.events = EPOLLIN;
+  ev.data = 1;
+  if(epoll_ctl(ep, EPOLL_CTL_ADD, a[0], &ev) < 0){
+    printf(1, "epoll: add failed\n");
+    exit();
+  }
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data = 2;
+  if(epoll_ctl(ep, EPOLL_CTL_ADD, b[0], &ev) < 0 ||
+     epoll_ctl(ep, EPOLL_CTL_ADD, b[0], &ev) != -1){
+    printf(1, "epoll: second add of an fd did not fail\n");
+    exit();
+  }
+  if(epoll_wait(ep, out, 4, 0) != 0){
+    printf(1, "epoll: empty pipes ready\n");
+    exit();
+  }
+  write(a[1], "x", 1);
+  write(b[1], "y", 1);
+  if(epoll_wait(ep, out, 4, -1) != 2){
+    printf(1, "epoll: not both ready\n");
+    exit();
+  }
+  // Level-triggered a stays ready; edge-triggered b does not.
+  if(epoll_wait(ep, out, 4, 0) != 1 || out[0].data != 1 || out[0].events != EPOLLIN){
+    printf(1, "epoll: wrong level-triggered events\n");
+    exit();
+  }
+  read(a[0], &c, 1);
+  if(epoll_wait(ep, out, 4, 2) != 0){
+    printf(1, "epoll: drained pipe still ready\n");
+    exit();
+  }
+  close(b[1]);
+  if(epoll_wait(ep, out, 4, -1) != 1 || out[0].data != 2 || !(out[0].events & EPOLLHUP)){
+    printf(1, "epoll: no hangup\n");
+    exit();
+  }
+  if(epoll_ctl(ep, EPOLL_CTL_DEL, b[0], 0) < 0){
+    printf(1, "epoll: del failed\n");
+    exit();
+  }
+  close(ep);
+  close(a[0]);
+  close(a[1]);
+  close(b[0]);
+  printf(1, "epoll ok\n");
+}
+
+// closing a watched fd without EPOLL_CTL_DEL
+void
+epollclosetest(void)
+{
+  int ep, fd, d, a[2], b[2];
+  char c;
+  struct epoll_event ev, out[4];
+
+  printf(1, "epoll close test\n");
+  if((ep = epoll_create()) < 0 || pipe(a) < 0){
+    printf(1, "epoll: setup failed\n");
+    exit();
+  }
+  ev.events = EPOLLOUT;
+  ev.data = 1;
+  if(epoll_ctl(ep, EPOLL_CTL_ADD, a[1], &ev) < 0){
+    printf(1, "epoll: add failed\n");
+    exit();
+  }
+  // The epoll must not keep the write end open.
+  fd = a[1];
+  close(a[1]);
+  if(read(a[0], &c, 1) != 0){
+    printf(1, "epoll: closed write end still open\n");
+    exit();
+  }
+  if(epoll_wait(ep, out, 4, 0) != 0){
+    printf(1, "epoll: closed fd still reported\n");
+    exit();
+  }
+  close(a[0]);
+
+  // A new file under the same fd number is a new item.
+  if(pipe(b) < 0 || b[0] != fd){
+    printf(1, "epoll: fd not reused\n");
+    exit();
+  }
+  ev.events = EPOLLIN;
+  ev.data = 2;
+  if(epoll_ctl(ep, EPOLL_CTL_ADD, b[0], &ev) < 0){
+    printf(1, "epoll: add of reused fd failed\n");
+    exit();
+  }
+  write(b[1], "x", 1);
+  if(epoll_wait(ep, out, 4, -1) != 1 || out[0].data != 2){
+    printf(1, "epoll: wrong events for reused fd\n");
+    exit();
+  }
+
+  // A dup keeps the file open, so its item stays until
+  // deleted under the closed fd.
+  if((d = dup(b[0])) < 0){
+    printf(1, "epoll: dup failed\n");
+    exit();
+  }
+  close(b[0]);
+  if(epoll_wait(ep, out, 4, 0) != 1 ||
+     epoll_ctl(ep, EPOLL_CTL_DEL, fd, 0) < 0 ||
+     epoll_wait(ep, out, 4, 0) != 0){
+    printf(1, "epoll: del of closed fd failed\n");
+    exit();
+  }
+  close(ep);
+  close(d);
+  close(b[1]);
+  printf(1, "epoll close ok\n");
+}
+
+struct io_ring ring;
+
+// Queue a request on ring.
+void
+ioringsub(int op, int fd, char *addr, int len, int off, int data)
+{
+  struct io_sqe *sqe = &ring.sq[ring.sqtail % IORING_SQSIZE];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->addr = addr;
+  sqe->len = len;
+  sqe->off = off;
+  sqe->data = data;
+  ring.sqtail++;
+}
+
+// a batch of requests through one ioring_enter()
+void
+ioringtest(void)
+{
+  int i, fd;
+  char buf[8];
+  struct io_cqe *cqe;
+
+  printf(1, "ioring test\n");
+  if(ioring_setup(&ring) < 0){
+    printf(1, "ioring: setup failed\n");
+    exit();
+  }
+  ioringsub(IORING_OP_OPEN, 0, "ioring", O_CREATE|O_RDWR, 0, 0);
+  if(ioring_enter(0) != 1 || ring.cqtail != 1 || (fd = ring.cq[0].res) < 0){
+    printf(1, "ioring: open failed\n");
+    exit();
+  }
+  ring.cqhead++;
+  ioringsub(IORING_OP_WRITE, fd, "abc", 3, -1, 1);
+  ioringsub(IORING_OP_WRITE, fd, "def", 3, -1, 2);
+  ioringsub(IORING_OP_WRITE, fd, "X", 1, 1, 3);
+  ioringsub(IORING_OP_FSYNC, fd, 0, 0, 0, 4);
+  ioringsub(IORING_OP_READ, fd, buf, 6, 0, 5);
+  ioringsub(IORING_OP_CLOSE, fd, 0, 0, 0, 6);
+  ioringsub(IORING_OP_CLOSE, fd, 0, 0, 0, 7);
+  if(ioring_enter(0) != 7){
+    printf(1, "ioring: batch not run\n");
+    exit();
+  }
+  for(i = 1; ring.cqhead != ring.cqtail; i++, ring.cqhead++){
+    cqe = &ring.cq[ring.cqhead % IORING_CQSIZE];
+    if(cqe->data != i || cqe->res != (i == 7 ? -1 : i == 5 ? 6 : i < 3 ? 3 : i == 3 ? 1 : 0)){
+      printf(1, "ioring: request %d returned %d\n", cqe->data, cqe->res);
+      exit();
+    }
+  }
+  buf[6] = 0;
+  if(i != 8 || strcmp(buf, "aXcdef") != 0){
+    printf(1, "ioring: wrong data\n");
+    exit();
+  }
+  unlink("ioring");
+  printf(1, "ioring ok\n");
+}
+
+// pid and clock reads from the vdso pages
+void
+vdsotest(void)
+{
+  int pid, ppid;
+  uint t, c;
+
+  printf(1, "vdso test\n");
+  t = uptime();
+  if(vgetpid() != getpid() || vticks() - t > 1 || vtime() < 1500000000){
+    printf(1, "vdso: wrong pid or time\n");
+    exit();
+  }
+  c = vclock();
+  sleep(2);
+  if(vclock() - c < 10000){
+    printf(1, "vdso: clock did not advance\n");
+    exit();
+  }
+  ppid = getpid();
+  pid = fork();
+  if(pid < 0){
+    printf(1, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    if(vgetpid() != getpid() || vgetppid() != ppid){
+      printf(1, "vdso: wrong pid in child\n");
+      exit();
+    }
+    exit();
+  }
+  wait();
+  printf(1, "vdso ok\n");
+}
+
+// getrusage() and wait4()
+void
+rusagetest(void)
+{
+  struct rusage ru, before, after;
+  int pid, pid2, fd, i;
+  char file[] = "ru0";
+
+  printf(1, "rusage test\n");
+  if(wait4(getpid(), &ru) != -1 || wait4(1, 0) != -1){
+    printf(1, "rusage: wait4 of a non-child succeeded\n");
+    exit();
+  }
+  if(getrusage(RUSAGE_CHILDREN, &before) < 0){
+    printf(1, "rusage: getrusage failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(1, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    sleep(2);
+    // More blocks than the cache holds, so some must be read in.
+    fd = -1;
+    for(i = 0; i <= NBUF; i++){
+      if(i % 100 == 0){
+        if(fd >= 0)
+          close(fd);
+        file[2] = '0' + i / 100;
+        if((fd = open(file, O_CREATE|O_RDWR)) < 0){
+          printf(1, "rusage: create failed\n");
+          exit();
+        }
+      }
+      if(write(fd, buf, BSIZE) != BSIZE){
+        printf(1, "rusage: write failed\n");
+        exit();
+      }
+    }
+    close(fd);
+    for(i = 0; i <= NBUF / 100; i++){
+      file[2] = '0' + i;
+      unlink(file);
+    }
+    exit();
+  }
+  pid2 = fork();
+  if(pid2 == 0)
+    exit();
+  if(pid2 < 0){
+    printf(1, "fork failed\n");
+    exit();
+  }
+  if(wait4(pid, &ru) != pid){
+    printf(1, "rusage: wait4 reaped the wrong child\n");
+    exit();
+  }
+  if(ru.inblock == 0 || ru.oublock == 0){
+    printf(1, "rusage: no blocks counted\n");
+    exit();
+  }
+  if(wait4(pid2, 0) != pid2 || wait4(pid2, 0) != -1){
+    printf(1, "rusage: wait4 of the second child failed\n");
+    exit();
+  }
+  getrusage(RUSAGE_CHILDREN, &after);
+  if(after.inblock < before.inblock + ru.inblock ||
+     after.oublock < before.oublock + ru.oublock){
+    printf(1, "rusage: children's usage did not grow\n");
+    exit();
+  }
+  printf(1, "rusage ok\n");
+}
+
 // meant to be run w/ at most two CPUs
 void
 preempt(void)
@@ -1347,7 +1874,7 @@ iref(void)
 
   printf(1, "empty file name\n");
 
-  // the 50 is NINODE
+  // the 50 was NINODE before the i-node cache could grow
   for(i = 0; i < 50 + 1; i++){
     if(mkdir("irefd") != 0){
       printf(1, "mkdir irefd failed\n");
@@ -1773,6 +2300,9 @@ main(int argc, char *argv[])
   opentest();
   writetest();
   writetest1();
+  piotest();
+  fsynctest();
+  splicetest();
   createtest();
 
   openiputtest();
@@ -1781,6 +2311,12 @@ main(int argc, char *argv[])
 
   mem();
   pipe1();
+  polltest();
+  epolltest();
+  epollclosetest();
+  ioringtest();
+  vdsotest();
+  rusagetest();
   preempt();
   exitwait();
 
@@ -0,0 +1,90 @@
+//
+// Kernel data that user processes read without a system call.
+//
+// vdata is one page mapped read-only into every process at
+// VDATA. CPU 0 updates it on every clock tick; readers retry
+// while seq is odd or changes under them. Each process also
+// gets its own read-only page at VPROC, see allocproc().
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "x86.h"
+#include "date.h"
+#include "vdso.h"
+
+#define HZ 100  // nominal clock ticks per second
+
+struct vdata *vdata;
+static uint boottime;  // wall-clock time when ticks was 0
+
+// Days from 1970-01-01 to the given date.
+static uint
+epochdays(uint y, uint m, uint d)
+{
+  uint era, yoe, doy;
+
+  if(m <= 2)
+    y--;
+  era = y / 400;
+  yoe = y - era * 400;
+  doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+void
+vdsoinit(void)
+{
+  struct rtcdate r;
+
+  if((vdata = (struct vdata*)kalloc()) == 0)
+    panic("vdsoinit");
+  memset(vdata, 0, PGSIZE);
+  if((uint)&((struct vdata*)VDATA)->nosysenter != VNOSYSENTER)
+    panic("vdsoinit: VNOSYSENTER");
+  vdata->nosysenter = nosysenter;
+  cmostime(&r);
+  boottime = epochdays(r.year, r.month, r.day) * 86400 +
+             r.hour * 3600 + r.minute * 60 + r.second;
+  vdata->time = boottime;
+  vdata->hz = HZ;
+}
+
+// Convert TSC cycles to microseconds,
+// using the rate seen over the last tick.
+uint
+tscus(unsigned long long c)
+{
+  uint d, hi, lo, q;
+
+  d = vdata->tscpertick / (1000000 / HZ);
+  if(d == 0)
+    return 0;
+  hi = c >> 32;
+  lo = c;
+  if(hi >= d)
+    return 0xffffffff;
+  asm("divl %4" : "=a" (q), "=d" (hi) : "0" (lo), "1" (hi), "rm" (d));
+  return q;
+}
+
+// Publish the new value of ticks. Called by CPU 0
+// on every clock tick, holding tickslock.
+void
+vdsotick(void)
+{
+  uint tsc;
+
+  tsc = rdtsc();
+  vdata->seq++;
+  __sync_synchronize();
+  vdata->ticks = ticks;
+  vdata->time = boottime + ticks / HZ;
+  if(vdata->tsc)
+    vdata->tscpertick = tsc - vdata->tsc;
+  vdata->tsc = tsc;
+  __sync_synchronize();
+  vdata->seq++;
+}
@@ -0,0 +1,27 @@
+// Read-only pages the kernel maps into every process just
+// below KERNBASE, so that a process can read the time and
+// its pid without a system call. See vdso.c, and the v*()
+// functions in ulib.c for the readers.
+
+#define VDATA  0x7FFFE000  // struct vdata, shared by all processes
+#define VPROC  0x7FFFF000  // struct vproc, the process's own
+
+// &((struct vdata*)VDATA)->nosysenter, for the stubs in usys.S
+#define VNOSYSENTER  (VDATA + 24)
+
+#ifndef __ASSEMBLER__
+struct vdata {
+  uint seq;         // odd while the kernel updates the fields below
+  uint ticks;       // what uptime() returns
+  uint time;        // wall-clock seconds since 1970-01-01 UTC
+  uint tsc;         // low 32 bits of the TSC at the last tick
+  uint tscpertick;  // TSC cycles in the last tick, 0 until known
+  uint hz;          // ticks per second
+  uint nosysenter;  // some CPU lacks SYSENTER, so use int $T_SYSCALL
+};
+
+struct vproc {
+  int pid;
+  int ppid;         // parent's pid, 0 for init
+};
+#endif
@@ -6,8 +6,11 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "vdso.h"
 
 extern char data[];  // defined by kernel.ld
+extern void sysentry(void);  // trapasm.S
+int nosysenter;  // some CPU lacks SYSENTER
 pde_t *kpgdir;  // for use in scheduler()
 
 // Set up CPU's kernel segment descriptors.
@@ -27,6 +30,25 @@ seginit(void)
   c->gdt[SEG_UCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, DPL_USER);
   c->gdt[SEG_UDATA] = SEG(STA_W, 0, 0xffffffff, DPL_USER);
   lgdt(c->gdt, sizeof(c->gdt));
+
+  // SYSENTER jumps to sysentry with %cs = SEG_KCODE and
+  // %ss = SEG_KDATA, and SYSEXIT returns with SEG_UCODE and
+  // SEG_UDATA, which the segment order above provides.
+  // It loads %esp from the MSR, so point that at ts.esp0,
+  // which switchuvm() keeps at the top of the current
+  // process's kernel stack.
+  if(cpuidedx(1) & CPUID_SEP){
+    wrmsr(MSR_SYSENTER_CS, SEG_KCODE<<3, 0);
+    wrmsr(MSR_SYSENTER_ESP, (uint)&c->ts.esp0, 0);
+    wrmsr(MSR_SYSENTER_EIP, (uint)sysentry, 0);
+  } else {
+    // Tell the stubs to use int $T_SYSCALL. vdsoinit() copies
+    // this for CPU 0; the others start after it.
+    cprintf("cpu%d: no SYSENTER, using int\n", cpuid());
+    nosysenter = 1;
+    if(vdata)
+      vdata->nosysenter = 1;
+  }
 }
 
 // Return the address of the PTE in page table pgdir
@@ -224,7 +246,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   char *mem;
   uint a;
 
-  if(newsz >= KERNBASE)
+  if(newsz > VDATA)
     return 0;
   if(newsz < oldsz)
     return oldsz;
@@ -287,7 +309,7 @@ freevm(pde_t *pgdir)
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
-  deallocuvm(pgdir, KERNBASE, 0);
+  deallocuvm(pgdir, VDATA, 0);  // the vdso pages are not the process's
   for(i = 0; i < NPDENTRIES; i++){
     if(pgdir[i] & PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));
@@ -310,6 +332,18 @@ clearpteu(pde_t *pgdir, char *uva)
   *pte &= ~PTE_U;
 }
 
+// Map the shared vdata page and the process's vproc page
+// read-only at VDATA and VPROC. freevm() leaves them alone.
+int
+vdsomap(pde_t *pgdir, struct vproc *vp)
+{
+  if(mappages(pgdir, (char*)VDATA, PGSIZE, V2P(vdata), PTE_U) < 0)
+    return -1;
+  if(mappages(pgdir, (char*)VPROC, PGSIZE, V2P(vp), PTE_U) < 0)
+    return -1;
+  return 0;
+}
+
 // Given a parent process's page table, create a copy
 // of it for a child.
 pde_t*
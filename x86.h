@@ -130,6 +130,50 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+// Low 32 bits of the time-stamp counter.
+static inline uint
+rdtsc(void)
+{
+  uint lo, hi;
+
+  asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+  return lo;
+}
+
+static inline void
+wrmsr(uint msr, uint lo, uint hi)
+{
+  asm volatile("wrmsr" : : "c" (msr), "a" (lo), "d" (hi));
+}
+
+// Return %edx of CPUID function op.
+static inline uint
+cpuidedx(uint op)
+{
+  uint eax, ebx, ecx, edx;
+
+  asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (op));
+  return edx;
+}
+
+// Atomically add n to *addr, returning the old value.
+static inline uint
+xadd(volatile uint *addr, uint n)
+{
+  asm volatile("lock; xaddl %0, %1" :
+               "+r" (n), "+m" (*addr) :
+               :
+               "cc");
+  return n;
+}
+
+// Spin-wait hint.
+static inline void
+pause(void)
+{
+  asm volatile("pause");
+}
+
 static inline uint
 rcr2(void)
 {